@@ -40,6 +40,10 @@ class __attribute__((packed)) CliffordGen {
     }
 
     [[nodiscard]] inline constexpr bool nonnull() const noexcept { return q1 != 0 || q2 != 0; };
+    // Generators on disjoint qubit pairs commute.
+    [[nodiscard]] inline constexpr bool disjoint(const CliffordGen& other) const noexcept {
+        return ictrl() != other.ictrl() && ictrl() != other.inot() && inot() != other.ictrl() && inot() != other.inot();
+    }
 
     template <typename Archive>
     void serialize(Archive& archive) {
@@ -47,6 +51,12 @@ class __attribute__((packed)) CliffordGen {
         archive(cereal::binary_data(this, sizeof(CliffordGen)));
     }
 
+    // Position in `all_generator()`, the byte stored in search trees.
+    [[nodiscard]] inline constexpr std::size_t index() const noexcept {
+        auto pair = std::size_t(ictrl()) * (N - 1) + inot() - std::size_t(inot() > ictrl());
+        return (std::size_t(op_ctrl()) * 3 + std::size_t(op_not())) * N * (N - 1) + pair;
+    }
+
     [[nodiscard]] static constexpr std::vector<CliffordGen<N>> all_generator() noexcept {
         std::vector<CliffordGenOp> generator_ops{CliffordGenOp::I, CliffordGenOp::HP, CliffordGenOp::PH};
         std::vector<CliffordGen<N>> result;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include "../../defines.hpp"
+#include "clifford_generator.hpp"
+
+namespace circ {
+
+// Undirected qubit connectivity. Generators are only placed on edges, in both orientations.
+template <std::size_t N>
+struct CouplingGraph {
+    std::array<std::array<bool, N>, N> adjacent{};
+
+    [[nodiscard]] inline constexpr static CouplingGraph from(std::initializer_list<std::pair<QIdx, QIdx>> edges) noexcept {
+        CouplingGraph graph;
+        for (auto [a, b] : edges) {
+            assert(a < N && b < N && a != b);
+            graph.adjacent[a][b] = graph.adjacent[b][a] = true;
+        }
+        return graph;
+    }
+    [[nodiscard]] inline constexpr static CouplingGraph complete() noexcept {
+        CouplingGraph graph;
+        for (auto a = 0ul; a < N; a++) {
+            for (auto b = 0ul; b < N; b++) {
+                graph.adjacent[a][b] = a != b;
+            }
+        }
+        return graph;
+    }
+    [[nodiscard]] inline constexpr static CouplingGraph line() noexcept {
+        CouplingGraph graph;
+        for (auto a = 1ul; a < N; a++) {
+            graph.adjacent[a - 1][a] = graph.adjacent[a][a - 1] = true;
+        }
+        return graph;
+    }
+    [[nodiscard]] inline constexpr static CouplingGraph ring() noexcept {
+        auto graph = line();
+        graph.adjacent[0][N - 1] = graph.adjacent[N - 1][0] = N > 2;
+        return graph;
+    }
+
+    [[nodiscard]] inline constexpr bool operator==(const CouplingGraph&) const noexcept = default;
+
+    // `perm[q]` is the new label of qubit `q`.
+    template <typename Perm>
+    [[nodiscard]] inline constexpr bool is_automorphism(const Perm& perm) const noexcept {
+        for (auto a = 0ul; a < N; a++) {
+            for (auto b = 0ul; b < N; b++) {
+                if (adjacent[perm[a]][perm[b]] != adjacent[a][b]) { return false; }
+            }
+        }
+        return true;
+    }
+
+    // The subset of `CliffordGen<N>::all_generator()` on edges, in the same order.
+    [[nodiscard]] inline constexpr std::vector<CliffordGen<N>> generators() const noexcept {
+        std::vector<CliffordGen<N>> result;
+        for (auto gen : CliffordGen<N>::all_generator()) {
+            if (adjacent[gen.ictrl()][gen.inot()]) { result.push_back(gen); }
+        }
+        return result;
+    }
+};
+
+}  // namespace circ
@@ -38,4 +38,17 @@ struct Gate0 {
 
 using Gate = std::variant<Gate0, Gate1, Gate2>;
 
+// `gate` with every qubit q replaced by `map(q)`.
+template <typename F>
+[[nodiscard]] inline Gate relabeled(Gate gate, F&& map) noexcept {
+    std::visit(
+        [&](auto& g) {
+            for (auto& q : g.qubits) {
+                q = QIdx(map(q));
+            }
+        },
+        gate);
+    return gate;
+}
+
 }  // namespace circ::gate
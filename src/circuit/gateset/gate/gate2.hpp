@@ -17,18 +17,23 @@ using QIdxVec = boost::container::static_vector<QIdx, 2>;
 struct Gate2 {
     struct CX {
         [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("CX"); }  // NOLINT
+        [[nodiscard]] inline auto operator<=>(const CX& other) const noexcept = default;
     };
     struct CZ {
         [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("CZ"); }  // NOLINT
+        [[nodiscard]] inline auto operator<=>(const CZ& other) const noexcept = default;
     };
     struct CY {
         [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("CY"); }  // NOLINT
+        [[nodiscard]] inline auto operator<=>(const CY& other) const noexcept = default;
     };
     struct CH {
         [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("CH"); }  // NOLINT
+        [[nodiscard]] inline auto operator<=>(const CH& other) const noexcept = default;
     };
     struct SWAP {
         [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("SWAP"); }  // NOLINT
+        [[nodiscard]] inline auto operator<=>(const SWAP& other) const noexcept = default;
     };
 
     using Variant = std::variant<CX, CZ, CY, CH, SWAP>;
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cassert>
 #include <cstddef>
 #include <span>
+#include <stdexcept>
 #include "../../utils/fmt.hpp"
 #include "../../utils/ranges.hpp"
 #include "range/v3/range_fwd.hpp"
@@ -125,17 +127,13 @@ class GroupedSpanBuilder {
 
     [[nodiscard]] inline std::vector<byte> build() {
         if (buffer.size() == 0) { return {}; }
-        assert(size_index < buffer.size());
-        buffer[size_index] = byte(buffer.size() - size_index - 1);
+        close_span();
         size_index = 0;
         buffer.shrink_to_fit();
         return std::move(buffer);
     }
     inline void new_span() {
-        if (buffer.size() > 0) {
-            assert(size_index < buffer.size());
-            buffer[size_index] = byte(buffer.size() - size_index - 1);
-        }
+        if (buffer.size() > 0) { close_span(); }
         buffer.push_back(byte(0));
         size_index = buffer.size() - 1;
     }
@@ -144,8 +142,26 @@ class GroupedSpanBuilder {
         assert(buffer.size() > 0);
         buffer.push_back(b);
     }
+
+   private:
+    // Span headers are one byte.
+    inline void close_span() {
+        assert(size_index < buffer.size());
+        auto size = buffer.size() - size_index - 1;
+        if (size > 0xff) { throw std::length_error(fmt::format("A span of {} children does not fit in a one-byte header", size)); }
+        buffer[size_index] = byte(size);
+    }
 };
 
+// Generator `g` as a tree byte. The root span holds one child per generator and its child count is a one-byte header,
+// so a tree takes at most 255 generators even though id 255 would fit in a node byte.
+[[nodiscard]] inline std::byte node_byte(std::size_t g) {
+    if (g >= 0xff) {
+        throw std::out_of_range(fmt::format("Generator {} exceeds the limit of 255 generators per tree set by the one-byte span header", g));
+    }
+    return std::byte(g);
+}
+
 inline std::string format_as(GroupedSpan iter) {
     return fmt::format("[{}]", fmt::join(iter | vw::transform([](auto a) { return fmt::format("({})", fmt::join(a, " ")); }), ", "));
 }
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "../../utils/fmt.hpp"
+#include "groupedspan.hpp"
+#include "packed.hpp"
+#include "tree.hpp"
+
+// On-disk `Tree` that is mapped instead of deserialized. Fields are in native byte order:
+//  - a `MappedHeader`;
+//  - `nlayers` `MappedLayer` records;
+//  - the layers, raw ones in `GroupedSpanBuilder` format starting on a page boundary and packed ones as `PackedLayer`
+//    bytes right after the previous layer.
+// The header checksum covers the layer records and each record carries the checksum of its stored bytes, so opening
+// only reads the first page and raw layers are checked on demand. Packed layers are checked and decoded on open, which
+// trades sharing their pages for a smaller file.
+namespace circ::tree {
+
+constexpr std::uint64_t MAPPED_MAGIC = 0x3145455254464c43;  // "CLFTREE1"
+constexpr std::uint32_t MAPPED_VERSION = 2;
+constexpr std::size_t MAPPED_ALIGN = 4096;
+
+enum class MappedEncoding : std::uint32_t { Raw = 0, Packed = 1 };
+
+struct MappedHeader {
+    std::uint64_t magic = MAPPED_MAGIC;
+    std::uint32_t version = MAPPED_VERSION;
+    std::uint32_t nlayers = 0;
+    std::uint64_t checksum = 0;
+};
+struct MappedLayer {
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t checksum;
+    MappedEncoding encoding = MappedEncoding::Raw;
+    std::uint32_t reserved = 0;
+};
+static_assert(sizeof(MappedHeader) == 24 && sizeof(MappedLayer) == 32);
+
+// FNV-1a over 64-bit words, then the trailing bytes.
+[[nodiscard]] inline std::uint64_t mapped_checksum(std::span<const std::byte> bytes) noexcept {
+    constexpr std::uint64_t PRIME = 0x100000001b3;
+    auto hash = std::uint64_t(0xcbf29ce484222325);
+    auto i = 0ul;
+    for (; i + 8 <= bytes.size(); i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes.data() + i, 8);
+        hash = (hash ^ word) * PRIME;
+    }
+    for (; i < bytes.size(); i++) {
+        hash = (hash ^ std::uint64_t(bytes[i])) * PRIME;
+    }
+    return hash ^ bytes.size();
+}
+
+// With `MappedEncoding::Packed`, each layer that packs smaller is stored packed.
+inline void save_mapped(const Tree& tree, const std::string& path, MappedEncoding encoding = MappedEncoding::Raw) {
+    std::vector<PackedLayer> packed;
+    std::vector<std::span<const std::byte>> stored;
+    std::vector<MappedLayer> records;
+    auto offset = sizeof(MappedHeader) + tree.nlayers() * sizeof(MappedLayer);
+    packed.reserve(tree.nlayers());
+    for (const auto& layer : tree.layers) {
+        if (encoding == MappedEncoding::Packed) { packed.push_back(PackedLayer::encode(GroupedSpan::from(layer))); }
+        auto pack = encoding == MappedEncoding::Packed && packed.back().bytes().size() < layer.size();
+        auto bytes = stored.emplace_back(pack ? packed.back().bytes() : std::span<const std::byte>(layer));
+        if (!pack) { offset = (offset + MAPPED_ALIGN - 1) / MAPPED_ALIGN * MAPPED_ALIGN; }
+        records.push_back({.offset = offset,
+                           .size = bytes.size(),
+                           .checksum = mapped_checksum(bytes),
+                           .encoding = pack ? MappedEncoding::Packed : MappedEncoding::Raw,
+                           .reserved = 0});
+        offset += bytes.size();
+    }
+    auto header = MappedHeader{.nlayers = std::uint32_t(tree.nlayers()), .checksum = mapped_checksum(std::as_bytes(std::span(records)))};
+
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs) { throw std::runtime_error(fmt::format("Failed to open {}", path)); }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));                                             // NOLINT
+    ofs.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(MappedLayer)));  // NOLINT
+    for (auto i = 0ul; i < tree.nlayers(); i++) {
+        auto padding = std::vector<char>(records[i].offset - std::size_t(ofs.tellp()));
+        ofs.write(padding.data(), std::streamsize(padding.size()));
+        ofs.write(reinterpret_cast<const char*>(stored[i].data()), std::streamsize(stored[i].size()));  // NOLINT
+    }
+    if (!ofs) { throw std::runtime_error(fmt::format("Failed to write {}", path)); }
+}
+
+// A read-only shared mapping of a file written by `save_mapped`. Raw layers are `GroupedSpan`s over the mapped pages,
+// so nothing is copied and processes mapping the same file share its page cache; packed layers are decoded into
+// memory of their own.
+class MappedTree {
+    void* data = nullptr;
+    std::size_t length = 0;
+    std::vector<MappedLayer> records;
+    std::vector<std::vector<std::byte>> decoded;
+    std::vector<GroupedSpan> spans;
+
+   public:
+    inline explicit MappedTree(const std::string& path) {
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { throw std::system_error(errno, std::generic_category(), "open " + path); }
+        struct stat st{};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            length = std::size_t(st.st_size);
+            data = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        auto error = errno;
+        ::close(fd);
+        if (data == MAP_FAILED || data == nullptr) {
+            data = nullptr;
+            throw std::system_error(error, std::generic_category(), "mmap " + path);
+        }
+
+        try {
+            auto bytes = std::span(static_cast<const std::byte*>(data), length);
+            MappedHeader header;
+            if (length < sizeof(header)) { throw std::runtime_error(fmt::format("{}: truncated header", path)); }
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            if (header.magic != MAPPED_MAGIC) { throw std::runtime_error(fmt::format("{}: not a mapped tree", path)); }
+            if (header.version != MAPPED_VERSION) { throw std::runtime_error(fmt::format("{}: unsupported version {}", path, header.version)); }
+            auto table = bytes.subspan(sizeof(header));
+            if (table.size() < header.nlayers * sizeof(MappedLayer)) { throw std::runtime_error(fmt::format("{}: truncated layer table", path)); }
+            table = table.first(header.nlayers * sizeof(MappedLayer));
+            if (mapped_checksum(table) != header.checksum) { throw std::runtime_error(fmt::format("{}: corrupt layer table", path)); }
+
+            records.resize(header.nlayers);
+            std::memcpy(records.data(), table.data(), table.size());
+            for (const auto& record : records) {
+                auto packed = record.encoding == MappedEncoding::Packed;
+                if (record.encoding != MappedEncoding::Raw && !packed) { throw std::runtime_error(fmt::format("{}: unknown layer encoding", path)); }
+                if ((!packed && record.offset % MAPPED_ALIGN != 0) || record.offset > length || record.size > length - record.offset) {
+                    throw std::runtime_error(fmt::format("{}: layer out of bounds", path));
+                }
+                auto layer = bytes.subspan(record.offset, record.size);
+                if (packed) {
+                    if (mapped_checksum(layer) != record.checksum) { throw std::runtime_error(fmt::format("{}: corrupt packed layer", path)); }
+                    layer = decoded.emplace_back(PackedLayer::decode(layer));
+                }
+                spans.emplace_back(layer.data(), layer.data() + layer.size());
+            }
+        } catch (...) {
+            ::munmap(data, length);
+            throw;
+        }
+    }
+    inline ~MappedTree() {
+        if (data != nullptr) { ::munmap(data, length); }
+    }
+    MappedTree(const MappedTree&) = delete;
+    MappedTree& operator=(const MappedTree&) = delete;
+    inline MappedTree(MappedTree&& other) noexcept
+        : data(std::exchange(other.data, nullptr)),
+          length(other.length),
+          records(std::move(other.records)),
+          decoded(std::move(other.decoded)),
+          spans(std::move(other.spans)) {}
+    MappedTree& operator=(MappedTree&&) = delete;
+
+    [[nodiscard]] inline std::size_t nlayers() const noexcept { return spans.size(); }
+    [[nodiscard]] inline std::span<const GroupedSpan> layers() const noexcept { return spans; }
+    [[nodiscard]] inline GroupedSpan layer(std::size_t i) const noexcept { return spans[i]; }
+
+    // Reads every raw layer once; use it after a copy or on untrusted storage.
+    [[nodiscard]] inline bool verify() const noexcept {
+        for (auto i = 0ul; i < nlayers(); i++) {
+            if (records[i].encoding == MappedEncoding::Raw && mapped_checksum(spans[i].span()) != records[i].checksum) { return false; }
+        }
+        return true;
+    }
+    // Bytes of the file, which raw layers share through the page cache, and of the decoded packed layers.
+    [[nodiscard]] inline std::size_t file_size() const noexcept { return length; }
+    [[nodiscard]] inline std::size_t decoded_size() const noexcept {
+        return rgs::accumulate(decoded | vw::transform([](auto&& layer) { return layer.size(); }), 0ul);
+    }
+
+    [[nodiscard]] inline Tree::Iter iter_layer(std::size_t nlayers) const noexcept { return Tree::Iter(layers(), nlayers); }
+    [[nodiscard]] inline Tree::Iter begin() const noexcept { return Tree::Iter(layers(), nlayers()); }
+    [[nodiscard]] inline Tree::Iter::Sentinel end() const noexcept { return {}; }
+};
+
+}  // namespace circ::tree
+
+// NOLINTBEGIN
+TEST_FN(mapped_tree) {
+    circ::tree::Tree tree;
+    circ::tree::GroupedSpanBuilder builder;
+    builder.new_span();
+    for (auto b : vw::ints(0, 9)) {
+        builder.add(std::byte(b));
+    }
+    tree.add_layer(builder.build());
+    for (auto i : vw::ints(0, 4)) {
+        for (auto node : tree) {
+            builder.new_span();
+            for (auto b : vw::ints(0, int(*node[node.size() - 1]) % 4)) {
+                builder.add(std::byte(b + i));
+            }
+        }
+        tree.add_layer(builder.build());
+    }
+
+    auto path = "/tmp/clifford-mapped-test-" + std::to_string(::getpid()) + ".bin";
+    circ::tree::save_mapped(tree, path);
+    {
+        auto mapped = circ::tree::MappedTree(path);
+        CHECK_EQ(mapped.nlayers(), tree.nlayers());
+        CHECK(mapped.verify());
+        for (auto i = 0ul; i < tree.nlayers(); i++) {
+            CHECK(rgs::equal(mapped.layer(i).span(), tree.layers[i]));
+            CHECK_EQ(reinterpret_cast<std::uintptr_t>(mapped.layer(i).span().data()) % circ::tree::MAPPED_ALIGN, 0);
+        }
+        auto flatten = [](auto node) { return node | vw::transform([](auto&& it) { return *it; }) | rgs::to<std::vector>(); };
+        auto expected = tree | vw::transform(flatten) | rgs::to<std::vector>();
+        auto actual = mapped | vw::transform(flatten) | rgs::to<std::vector>();
+        CHECK_EQ(actual, expected);
+        CHECK_EQ(rgs::distance(mapped.iter_layer(2), mapped.end()), rgs::distance(tree.iter_layer(2), tree.end()));
+
+    }
+
+    circ::tree::save_mapped(tree, path, circ::tree::MappedEncoding::Packed);
+    {
+        auto packed = circ::tree::MappedTree(path);
+        CHECK(packed.verify());
+        CHECK(packed.decoded_size() > 0);
+        for (auto i = 0ul; i < tree.nlayers(); i++) {
+            CHECK(rgs::equal(packed.layer(i).span(), tree.layers[i]));
+        }
+    }
+    circ::tree::save_mapped(tree, path);
+
+    auto corrupt = [&path](std::size_t offset) {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(std::streamoff(offset));
+        auto c = char(file.get());
+        file.seekp(std::streamoff(offset));
+        file.put(char(c ^ 1));
+    };
+    corrupt(circ::tree::MAPPED_ALIGN * 2);
+    CHECK(!circ::tree::MappedTree(path).verify());
+    corrupt(sizeof(circ::tree::MappedHeader));
+    CHECK_THROWS(circ::tree::MappedTree(path));
+    corrupt(0);
+    CHECK_THROWS(circ::tree::MappedTree(path));
+    ::unlink(path.c_str());
+    CHECK_THROWS(circ::tree::MappedTree(path));
+}
+// NOLINTEND
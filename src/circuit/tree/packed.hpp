@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+#include "groupedspan.hpp"
+
+namespace circ::tree {
+
+// A `GroupedSpan` layer with each span stored in the smallest of three containers, chosen per span by its header byte:
+//  - `0xxxxxxx`: a list of that many bytes, as in `GroupedSpanBuilder`; `0x7f` is followed by the length in a byte;
+//  - `10xxxxxx`: that many bytes as 4-bit gaps, `b[i] - b[i - 1] - 1` with `b[-1] = -1`, two per byte;
+//  - `11xxxxxx`: a bitmap of that many bytes, bit `b` set for each byte `b`.
+// Lists and gaps keep their order; bitmaps and gaps need ascending bytes, which is how the search adds generators.
+class PackedLayer {
+    using byte = std::byte;
+    constexpr static std::uint8_t LONG_LIST = 0x7f;
+
+    std::vector<byte> data;
+    std::size_t nspans = 0;
+    std::size_t nnodes = 0;
+
+   public:
+    inline explicit PackedLayer() = default;
+    [[nodiscard]] inline static PackedLayer encode(GroupedSpan layer) {
+        PackedLayer result;
+        for (auto span : layer) {
+            result.append(span);
+        }
+        return result;
+    }
+
+    [[nodiscard]] inline std::span<const byte> bytes() const noexcept { return data; }
+    [[nodiscard]] inline std::size_t spans() const noexcept { return nspans; }
+    [[nodiscard]] inline std::size_t count() const noexcept { return nnodes; }
+
+    // Calls `f` with each span of the packed `bytes` decoded, in order.
+    template <typename F>
+    inline static void for_each(std::span<const byte> bytes, F&& f) {
+        std::array<byte, 256> buffer;
+        for (auto pos = 0ul; pos < bytes.size();) {
+            auto header = std::uint8_t(bytes[pos++]);
+            auto n = std::size_t(header & 0x3f);
+            auto size = 0ul;
+            if (header < 0x80) {
+                auto length = header == LONG_LIST ? std::size_t(bytes[pos++]) : std::size_t(header);
+                f(bytes.subspan(pos, length));
+                pos += length;
+                continue;
+            }
+            if (header < 0xc0) {
+                auto value = -1;
+                for (auto i = 0ul; i < n; i++) {
+                    value += int((std::uint8_t(bytes[pos + i / 2]) >> (i % 2 * 4)) & 0xf) + 1;
+                    buffer[size++] = byte(value);
+                }
+                pos += (n + 1) / 2;
+            } else {
+                for (auto i = 0ul; i < n; i++) {
+                    for (auto bits = std::uint8_t(bytes[pos + i]); bits != 0; bits &= bits - 1) {
+                        buffer[size++] = byte(i * 8 + std::size_t(std::countr_zero(bits)));
+                    }
+                }
+                pos += n;
+            }
+            f(std::span<const byte>(buffer).first(size));
+        }
+    }
+    template <typename F>
+    inline void for_each(F&& f) const {
+        for_each(data, std::forward<F>(f));
+    }
+
+    // Back to the `GroupedSpanBuilder` format.
+    [[nodiscard]] inline static std::vector<byte> decode(std::span<const byte> bytes) {
+        GroupedSpanBuilder builder;
+        for_each(bytes, [&builder](std::span<const byte> span) {
+            builder.new_span();
+            for (auto b : span) {
+                builder.add(b);
+            }
+        });
+        return builder.build();
+    }
+    [[nodiscard]] inline std::vector<byte> decode() const { return decode(data); }
+
+   private:
+    inline void append(std::span<const byte> span) {
+        nspans++;
+        nnodes += span.size();
+        auto ascending = !span.empty() && std::ranges::adjacent_find(span, std::ranges::greater_equal{}) == span.end();
+        auto gaps = ascending && span.size() < 0x40;
+        auto bitmap = ascending ? (std::size_t(span.back()) + 8) / 8 : 0x40;
+        for (auto i = 0ul; gaps && i < span.size(); i++) {
+            gaps = std::size_t(span[i]) - (i == 0 ? 0 : std::size_t(span[i - 1]) + 1) < 16;
+        }
+        auto list_size = span.size() < LONG_LIST ? span.size() : span.size() + 1;
+        auto gaps_size = gaps ? (span.size() + 1) / 2 : 0x100;
+        auto bitmap_size = bitmap < 0x40 ? bitmap : 0x100;
+
+        if (list_size <= gaps_size && list_size <= bitmap_size) {
+            if (span.size() >= LONG_LIST) { data.push_back(byte(LONG_LIST)); }
+            data.push_back(byte(span.size()));
+            data.insert(data.end(), span.begin(), span.end());
+        } else if (gaps_size <= bitmap_size) {
+            data.push_back(byte(0x80 | span.size()));
+            auto first = data.size();
+            data.resize(first + gaps_size, byte(0));
+            for (auto i = 0ul; i < span.size(); i++) {
+                auto gap = std::size_t(span[i]) - (i == 0 ? 0 : std::size_t(span[i - 1]) + 1);
+                data[first + i / 2] |= byte(gap << (i % 2 * 4));
+            }
+        } else {
+            data.push_back(byte(0xc0 | bitmap_size));
+            auto first = data.size();
+            data.resize(first + bitmap_size, byte(0));
+            for (auto b : span) {
+                data[first + std::size_t(b) / 8] |= byte(1u << (std::size_t(b) % 8));
+            }
+        }
+    }
+};
+
+}  // namespace circ::tree
+
+// NOLINTBEGIN
+TEST_FN(packed_layer) {
+    std::mt19937 gen(11);
+    for (auto density : {0.02, 0.1, 0.5, 0.9}) {
+        std::bernoulli_distribution dis(density);
+        std::uniform_int_distribution<int> universe(1, 160);
+        circ::tree::GroupedSpanBuilder builder;
+        auto nodes = 0ul;
+        for (auto i = 0; i < 500; i++) {
+            builder.new_span();
+            for (auto b : vw::ints(0, universe(gen))) {
+                if (dis(gen)) {
+                    builder.add(std::byte(b));
+                    nodes++;
+                }
+            }
+        }
+        builder.new_span();
+        for (auto b : {7, 3, 200, 3}) {
+            builder.add(std::byte(b));
+        }
+        auto raw = builder.build();
+        auto packed = circ::tree::PackedLayer::encode(circ::tree::GroupedSpan::from(raw));
+        CHECK_EQ(packed.decode(), raw);
+        CHECK_EQ(packed.spans(), 501);
+        CHECK_EQ(packed.count(), nodes + 4);
+        CHECK(packed.bytes().size() <= raw.size());
+        if (density >= 0.5) { CHECK(packed.bytes().size() * 2 < raw.size()); }
+    }
+
+    // Spans out of order stay lists, including ones too long for the short list header.
+    circ::tree::GroupedSpanBuilder builder;
+    builder.new_span();
+    for (auto b : {7, 3, 200, 3}) {
+        builder.add(std::byte(b));
+    }
+    builder.new_span();
+    for (auto b : vw::ints(0, 200)) {
+        builder.add(std::byte(199 - b));
+    }
+    auto raw = builder.build();
+    auto packed = circ::tree::PackedLayer::encode(circ::tree::GroupedSpan::from(raw));
+    CHECK_EQ(packed.decode(), raw);
+    CHECK_EQ(packed.bytes().size(), raw.size() + 1);
+}
+// NOLINTEND
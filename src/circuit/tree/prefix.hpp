@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <set>
+#include <utility>
+#include <vector>
+#include "tree.hpp"
+
+namespace circ::tree {
+
+// Walks a `Tree::Iter` and keeps `step` folded over every prefix of the current node, starting from `root`. Advancing
+// only refolds the layers from `Tree::Iter::first_changed()` on, and every node of a layer becomes current once, so a
+// full walk calls `step` once per node of every layer instead of once per byte of every path.
+template <typename Value, typename StepF>
+class PrefixIter {
+    Tree::Iter iter;
+    Value root;
+    StepF step;
+    std::vector<Value> stack;
+
+   public:
+    inline explicit PrefixIter(Tree::Iter iter, Value root, StepF step) : iter(std::move(iter)), root(std::move(root)), step(std::move(step)) {
+        refresh();
+    }
+
+    [[nodiscard]] inline explicit operator bool() const noexcept { return bool(iter); }
+    [[nodiscard]] inline const Tree::Iter& node() const noexcept { return iter; }
+    // The fold over the whole current node.
+    [[nodiscard]] inline const Value& value() const noexcept { return stack.back(); }
+    // The fold over the first `layer + 1` bytes of the current node.
+    [[nodiscard]] inline const Value& prefix(std::size_t layer) const noexcept { return stack[layer]; }
+
+    inline PrefixIter& operator++() {
+        ++iter;
+        refresh();
+        return *this;
+    }
+    inline PrefixIter& next_parent() {
+        iter.next_parent();
+        refresh();
+        return *this;
+    }
+
+   private:
+    inline void refresh() {
+        if (!iter) { return; }
+        stack.resize(iter.nlayers(), root);
+        for (auto l = iter.first_changed(); l < iter.nlayers(); l++) {
+            stack[l] = step(l == 0 ? root : stack[l - 1], iter[l]);
+        }
+    }
+};
+
+}  // namespace circ::tree
+
+// NOLINTBEGIN
+TEST_FN(prefix_iter) {
+    circ::tree::Tree tree;
+    circ::tree::GroupedSpanBuilder builder;
+    builder.new_span();
+    for (auto b : vw::ints(0, 6)) {
+        builder.add(std::byte(b));
+    }
+    tree.add_layer(builder.build());
+    for (auto i : vw::ints(0, 4)) {
+        for (auto node : tree) {
+            builder.new_span();
+            for (auto b : vw::ints(0, (int(*node[node.size() - 1]) + i) % 4)) {
+                builder.add(std::byte(b + 10 * i));
+            }
+        }
+        tree.add_layer(builder.build());
+    }
+
+    auto steps = 0ul;
+    auto step = [&steps](std::vector<std::byte> path, std::byte b) {
+        steps++;
+        path.push_back(b);
+        return path;
+    };
+    auto leaves = 0ul;
+    std::set<std::vector<std::byte>> prefixes;
+    for (auto it = circ::tree::PrefixIter(tree.begin(), std::vector<std::byte>(), step); it; ++it) {
+        auto expected = *it.node() | vw::transform([](auto&& g) { return *g; }) | rgs::to<std::vector>();
+        CHECK_EQ(it.value(), expected);
+        CHECK_EQ(it.prefix(1), std::vector(expected.begin(), expected.begin() + 2));
+        for (auto l = 1ul; l <= expected.size(); l++) {
+            prefixes.insert(std::vector(expected.begin(), expected.begin() + std::ptrdiff_t(l)));
+        }
+        leaves++;
+    }
+    CHECK_EQ(leaves, rgs::distance(tree.begin(), tree.end()));
+    // Each node with a descendant in the last layer is folded exactly once.
+    CHECK_EQ(steps, prefixes.size());
+
+    auto parents = 0ul;
+    for (auto it = circ::tree::PrefixIter(tree.begin(), std::vector<std::byte>(), step); it; it.next_parent()) {
+        CHECK_EQ(it.value().size(), tree.nlayers());
+        parents++;
+    }
+    CHECK(parents < leaves);
+}
+// NOLINTEND
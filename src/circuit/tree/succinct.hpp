@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+#include "groupedspan.hpp"
+#include "tree.hpp"
+
+namespace circ::tree {
+
+// Bit vector with constant-time rank and select. Cumulative counts are kept per 512-bit block, and the block of every
+// 512th one and zero is sampled so select only searches the blocks between two samples.
+class RankSelect {
+    static constexpr std::size_t BLOCK = 512;
+    static constexpr std::size_t WORDS = BLOCK / 64;
+    static constexpr std::size_t SAMPLE = 512;
+
+    std::vector<std::uint64_t> words;
+    std::vector<std::uint64_t> ranks;  // ones before each block
+    std::vector<std::uint32_t> ones;   // block of every SAMPLE-th one
+    std::vector<std::uint32_t> zeros;  // block of every SAMPLE-th zero
+    std::size_t nbits = 0;
+
+   public:
+    inline explicit RankSelect() = default;
+
+    inline void push_back(bool bit) noexcept {
+        if (nbits % 64 == 0) { words.push_back(0); }
+        words.back() |= std::uint64_t(bit) << (nbits % 64);
+        nbits++;
+    }
+    // Call once after the last `push_back`.
+    inline void build() {
+        ranks.clear();
+        ones.clear();
+        zeros.clear();
+        auto count = 0ul;
+        for (auto block = 0ul; block * BLOCK < nbits; block++) {
+            ranks.push_back(count);
+            for (auto w = block * WORDS; w < std::min(words.size(), (block + 1) * WORDS); w++) {
+                auto before = count;
+                count += std::size_t(std::popcount(words[w]));
+                auto zeros_before = w * 64 - before;
+                auto zeros_after = std::min((w + 1) * 64, nbits) - count;
+                for (auto k = (before + SAMPLE - 1) / SAMPLE * SAMPLE; k < count; k += SAMPLE) {
+                    ones.push_back(std::uint32_t(block));
+                }
+                for (auto k = (zeros_before + SAMPLE - 1) / SAMPLE * SAMPLE; k < zeros_after; k += SAMPLE) {
+                    zeros.push_back(std::uint32_t(block));
+                }
+            }
+        }
+        ranks.push_back(count);
+    }
+
+    [[nodiscard]] inline std::size_t size() const noexcept { return nbits; }
+    [[nodiscard]] inline std::size_t count_ones() const noexcept { return ranks.empty() ? 0 : ranks.back(); }
+    [[nodiscard]] inline std::size_t bytes() const noexcept {
+        return words.size() * sizeof(std::uint64_t) + ranks.size() * sizeof(std::uint64_t) + (ones.size() + zeros.size()) * sizeof(std::uint32_t);
+    }
+    [[nodiscard]] inline bool operator[](std::size_t i) const noexcept {
+        assert(i < nbits);
+        return ((words[i / 64] >> (i % 64)) & 1) != 0;
+    }
+
+    // Ones in [0, i).
+    [[nodiscard]] inline std::size_t rank1(std::size_t i) const noexcept {
+        assert(i <= nbits);
+        auto result = std::size_t(ranks[i / BLOCK]);
+        for (auto w = i / BLOCK * WORDS; w < i / 64; w++) {
+            result += std::size_t(std::popcount(words[w]));
+        }
+        if (i % 64 != 0) { result += std::size_t(std::popcount(words[i / 64] & ((std::uint64_t(1) << (i % 64)) - 1))); }
+        return result;
+    }
+    [[nodiscard]] inline std::size_t rank0(std::size_t i) const noexcept { return i - rank1(i); }
+
+    // Position of the k-th one, from 0.
+    [[nodiscard]] inline std::size_t select1(std::size_t k) const noexcept { return select<true>(k); }
+    [[nodiscard]] inline std::size_t select0(std::size_t k) const noexcept { return select<false>(k); }
+
+   private:
+    template <bool ONE>
+    [[nodiscard]] inline std::size_t select(std::size_t k) const noexcept {
+        const auto& samples = ONE ? ones : zeros;
+        assert(k / SAMPLE < samples.size());
+        auto before = [this](std::size_t block) { return ONE ? ranks[block] : block * BLOCK - ranks[block]; };
+        auto low = std::size_t(samples[k / SAMPLE]);
+        auto high = k / SAMPLE + 1 < samples.size() ? std::size_t(samples[k / SAMPLE + 1]) + 1 : ranks.size() - 1;
+        while (high - low > 1) {
+            auto mid = low + (high - low) / 2;
+            if (before(mid) <= k) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        k -= before(low);
+        for (auto w = low * WORDS;; w++) {
+            auto word = ONE ? words[w] : ~words[w];
+            auto count = std::size_t(std::popcount(word));
+            if (k < count) {
+                for (; k > 0; k--) {
+                    word &= word - 1;
+                }
+                return w * 64 + std::size_t(std::countr_zero(word));
+            }
+            k -= count;
+        }
+    }
+};
+
+// `size` consecutive nodes of one layer starting from node `offset`.
+struct TreePartition {
+    Tree::Iter first;
+    std::size_t offset;
+    std::size_t size;
+
+    [[nodiscard]] inline auto nodes() const { return first | vw::take(size); }
+};
+
+// Random access into the layers of a `Tree`, which it borrows. Layer l is described by the degrees of the nodes of layer
+// l - 1 (of the root for layer 0) in unary, a one per child then a zero, which is the same information as the span
+// headers of the layer at one bit per byte. With node k of layer l at bit `select1(k)`, its parent is `select1(k) - k`,
+// its byte is at `k + parent + 1` in the layer, and the children of node p are the ones between zeros p - 1 and p.
+class SuccinctIndex {
+    using byte = std::byte;
+
+    std::vector<GroupedSpan> layers;
+    std::vector<RankSelect> degrees;
+
+   public:
+    inline explicit SuccinctIndex() = default;
+    [[nodiscard]] inline static SuccinctIndex from(const Tree& tree) {
+        return from(tree.layers | vw::transform([](auto&& layer) { return GroupedSpan::from(layer); }) | rgs::to<std::vector>());
+    }
+    [[nodiscard]] inline static SuccinctIndex from(std::span<const GroupedSpan> layers) {
+        SuccinctIndex index;
+        index.layers.assign(layers.begin(), layers.end());
+        for (auto layer : layers) {
+            auto& degree = index.degrees.emplace_back();
+            for (auto span : layer) {
+                for (auto i = 0ul; i < span.size(); i++) {
+                    degree.push_back(true);
+                }
+                degree.push_back(false);
+            }
+            degree.build();
+        }
+        return index;
+    }
+
+    [[nodiscard]] inline std::size_t nlayers() const noexcept { return layers.size(); }
+    [[nodiscard]] inline std::size_t layer_size(std::size_t layer) const noexcept { return degrees[layer].count_ones(); }
+    // Bytes of the index, not counting the borrowed layers.
+    [[nodiscard]] inline std::size_t bytes() const noexcept {
+        return rgs::accumulate(degrees | vw::transform([](auto&& degree) { return degree.bytes(); }), 0ul);
+    }
+
+    // Ordinal in layer `layer - 1` of the parent of node `ordinal`; 0 for the nodes of layer 0.
+    [[nodiscard]] inline std::size_t parent(std::size_t layer, std::size_t ordinal) const noexcept {
+        assert(layer < nlayers() && ordinal < layer_size(layer));
+        return degrees[layer].select1(ordinal) - ordinal;
+    }
+    [[nodiscard]] inline byte node(std::size_t layer, std::size_t ordinal) const noexcept {
+        return layers[layer].span()[ordinal + parent(layer, ordinal) + 1];
+    }
+    // Ordinals in layer `layer + 1` of the children of node `ordinal`, as a half-open range.
+    [[nodiscard]] inline std::pair<std::size_t, std::size_t> children(std::size_t layer, std::size_t ordinal) const noexcept {
+        if (layer + 1 >= nlayers()) { return {0, 0}; }
+        const auto& degree = degrees[layer + 1];
+        auto first = ordinal == 0 ? 0 : degree.select0(ordinal - 1) + 1 - ordinal;
+        return {first, degree.select0(ordinal) - ordinal};
+    }
+
+    // An iterator over the first `layer + 1` layers that starts at node `ordinal` of `layer`, with every ancestor
+    // positioned as if iteration had started from `begin()`.
+    [[nodiscard]] inline Tree::Iter at(std::size_t layer, std::size_t ordinal) const {
+        assert(layer < nlayers() && ordinal < layer_size(layer));
+        std::vector<GroupedSpanIter> indices(layer + 1, GroupedSpanIter(GroupedSpan()));
+        for (auto l = layer; l != std::size_t(-1); --l) {
+            auto p = parent(l, ordinal);
+            // The header of span p follows the p-th zero, and its first child is the first one after it.
+            auto header = p == 0 ? 0 : degrees[l].select0(p - 1) + 1;
+            auto it = GroupedSpanIter(layers[l].skip_size_unchecked(header));
+            it.current = it.current.subspan(ordinal - (header - p));
+            indices[l] = it;
+            ordinal = p;
+        }
+        return Tree::Iter(std::move(indices));
+    }
+
+    // Splits the nodes of `layer` into at most `nparts` contiguous ranges of nearly equal size, each with its own
+    // iterator, so subtrees can be walked on separate threads.
+    [[nodiscard]] inline std::vector<TreePartition> partition(std::size_t layer, std::size_t nparts) const {
+        std::vector<TreePartition> result;
+        auto size = layer_size(layer);
+        nparts = std::max(nparts, 1ul);
+        for (auto i = 0ul; i < nparts; i++) {
+            auto first = size * i / nparts;
+            auto last = size * (i + 1) / nparts;
+            if (first < last) { result.push_back({.first = at(layer, first), .offset = first, .size = last - first}); }
+        }
+        return result;
+    }
+
+    // Bytes from the root down to node `ordinal` of `layer`.
+    [[nodiscard]] inline std::vector<byte> path(std::size_t layer, std::size_t ordinal) const noexcept {
+        std::vector<byte> result(layer + 1);
+        for (auto l = layer; l != std::size_t(-1); --l) {
+            auto p = parent(l, ordinal);
+            result[l] = layers[l].span()[ordinal + p + 1];
+            ordinal = p;
+        }
+        return result;
+    }
+};
+
+}  // namespace circ::tree
+
+// NOLINTBEGIN
+TEST_FN(rank_select) {
+    std::mt19937 gen(3);
+    for (auto density : {0.5, 0.02, 0.98}) {
+        std::bernoulli_distribution dis(density);
+        circ::tree::RankSelect bits;
+        std::vector<std::size_t> ones, zeros;
+        for (auto i = 0ul; i < 20000ul; i++) {
+            auto bit = dis(gen);
+            bits.push_back(bit);
+            (bit ? ones : zeros).push_back(i);
+        }
+        bits.build();
+        CHECK_EQ(bits.count_ones(), ones.size());
+        for (auto i = 0ul; i < ones.size(); i++) {
+            CHECK_EQ(bits.select1(i), ones[i]);
+            CHECK_EQ(bits.rank1(ones[i]), i);
+        }
+        for (auto i = 0ul; i < zeros.size(); i++) {
+            CHECK_EQ(bits.select0(i), zeros[i]);
+            CHECK_EQ(bits.rank0(zeros[i]), i);
+        }
+        CHECK_EQ(bits.rank1(bits.size()), ones.size());
+    }
+}
+
+TEST_FN(succinct_index) {
+    circ::tree::Tree tree;
+    circ::tree::GroupedSpanBuilder builder;
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> dis(0, 4);
+    builder.new_span();
+    for (auto b : vw::ints(0, 200)) {
+        builder.add(std::byte(b));
+    }
+    tree.add_layer(builder.build());
+    for (auto i : vw::ints(0, 5)) {
+        for (auto node : tree) {
+            builder.new_span();
+            for (auto b : vw::ints(0, dis(gen))) {
+                builder.add(std::byte(b + i));
+            }
+        }
+        tree.add_layer(builder.build());
+    }
+
+    // Parent ordinal and byte of every node, read straight off the spans.
+    std::vector<std::vector<std::pair<std::size_t, std::byte>>> nodes;
+    for (const auto& layer : tree.layers) {
+        auto& flat = nodes.emplace_back();
+        auto parent = 0ul;
+        for (auto span : circ::tree::GroupedSpan::from(layer)) {
+            for (auto b : span) {
+                flat.emplace_back(parent, b);
+            }
+            parent += 1;
+        }
+    }
+
+    auto index = circ::tree::SuccinctIndex::from(tree);
+    CHECK_EQ(index.nlayers(), nodes.size());
+    auto raw = 0ul;
+    for (auto layer = 0ul; layer < index.nlayers(); layer++) {
+        raw += tree.layers[layer].size();
+        CHECK_EQ(index.layer_size(layer), nodes[layer].size());
+        for (auto ordinal = 0ul; ordinal < index.layer_size(layer); ordinal++) {
+            CHECK_EQ(index.node(layer, ordinal), nodes[layer][ordinal].second);
+            CHECK_EQ(index.parent(layer, ordinal), nodes[layer][ordinal].first);
+            if (layer + 1 < nodes.size()) {
+                auto [first, last] = index.children(layer, ordinal);
+                auto is_child = [ordinal](auto&& node) { return node.first == ordinal; };
+                CHECK_EQ(last - first, std::size_t(rgs::count_if(nodes[layer + 1], is_child)));
+                CHECK(rgs::all_of(vw::ints(first, last), [&](auto child) { return nodes[layer + 1][child].first == ordinal; }));
+            }
+            std::vector<std::byte> path(layer + 1);
+            for (auto l = layer, o = ordinal; l != std::size_t(-1); o = nodes[l][o].first, --l) {
+                path[l] = nodes[l][o].second;
+            }
+            CHECK_EQ(index.path(layer, ordinal), path);
+        }
+    }
+    // One bit per layer byte plus the rank and select directories.
+    CHECK(index.bytes() * 6 < raw);
+
+    for (auto layer = 0ul; layer < tree.nlayers(); layer++) {
+        auto flatten = [](auto node) { return node | vw::transform([](auto&& it) { return *it; }) | rgs::to<std::vector>(); };
+        auto expected = tree.iter_layer(layer + 1) | vw::transform(flatten) | rgs::to<std::vector>();
+        for (auto nparts : {1ul, 3ul, 7ul, expected.size() + 5}) {
+            auto parts = index.partition(layer, nparts);
+            CHECK(parts.size() <= nparts);
+            std::vector<std::vector<std::byte>> actual;
+            for (const auto& part : parts) {
+                CHECK_EQ(part.offset, actual.size());
+                for (auto node : part.nodes()) {
+                    actual.push_back(flatten(node));
+                }
+            }
+            CHECK_EQ(actual, expected);
+        }
+    }
+}
+// NOLINTEND
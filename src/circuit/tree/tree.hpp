@@ -2,6 +2,7 @@
 
 #include <cereal/cereal.hpp>
 #include <cereal/types/vector.hpp>
+#include <algorithm>
 #include <cstddef>
 #include <iterator>
 #include <ranges>
@@ -21,6 +22,7 @@ class Tree : public rgs::view_base {
 
     class Iter {
         std::vector<tree::GroupedSpanIter> indices;
+        std::size_t changed = 0;
 
        public:
         Iter() { assert(false); }
@@ -34,6 +36,13 @@ class Tree : public rgs::view_base {
                       rgs::to<std::vector>();
             maintain();
         }
+        // Resumes at a node given by one iterator per layer, as built by `SuccinctIndex::at`.
+        explicit Iter(std::vector<tree::GroupedSpanIter> indices) : indices(std::move(indices)) { assert(check()); }
+        // Over the first `nlayers` of layers stored elsewhere, such as a `MappedTree`.
+        explicit Iter(std::span<const GroupedSpan> layers, std::size_t nlayers) {
+            indices = layers.first(nlayers) | vw::transform([](auto layer) { return GroupedSpanIter(layer); }) | rgs::to<std::vector>();
+            maintain();
+        }
 
         [[nodiscard]] inline constexpr byte operator[](std::size_t i) const noexcept { return *indices[i]; }
         [[nodiscard]] inline bool check() {
@@ -59,6 +68,7 @@ class Tree : public rgs::view_base {
             for (auto i : vw::ints(0ul, indices.size())) {  // NOLINT
                 if (!indices[i]) {
                     assert(!indices[i].finished());
+                    changed = std::min(changed, i);
                     indices[i].next_span();
                     increment(i);
                     return false;
@@ -68,6 +78,7 @@ class Tree : public rgs::view_base {
         }
         inline constexpr void increment(std::size_t lt_layer) {
             for (auto i = lt_layer - 1; i != std::size_t(-1); --i) {
+                changed = std::min(changed, i);
                 auto&& it = ++indices[i];
                 [[likely]]
                 if (it) {
@@ -81,6 +92,7 @@ class Tree : public rgs::view_base {
        public:
         inline constexpr Iter& operator++() {
             assert(*this && check());
+            changed = indices.size();
             increment(indices.size());
             maintain();
             return *this;
@@ -88,6 +100,7 @@ class Tree : public rgs::view_base {
 
         inline constexpr Iter& next_parent() {
             assert(*this && check());
+            changed = indices.size() - 1;
             indices.back().next_span(false);
             increment(indices.size() - 1);
             maintain();
@@ -100,16 +113,18 @@ class Tree : public rgs::view_base {
         IMPL_FORWARD_ITER(Iter);
 
         [[nodiscard]] inline std::size_t nlayers() const noexcept { return indices.size(); }
+        // Layers below this one hold the same bytes as before the last advance; 0 for a new iterator.
+        [[nodiscard]] inline std::size_t first_changed() const noexcept { return changed; }
         [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("{}", fmt::join(indices, " ")); }
     };
 
     inline explicit Tree() = default;
     template <typename Rng>
-    [[nodiscard]] inline static Tree from(Rng&& layer) noexcept {
+    [[nodiscard]] inline static Tree from(Rng&& layer) {
         GroupedSpanBuilder builder;
         builder.new_span();
         for (auto&& elem : layer) {
-            builder.add(std::byte(elem));
+            builder.add(node_byte(std::size_t(elem)));
         }
 
         Tree tree;
@@ -139,7 +154,7 @@ class Tree : public rgs::view_base {
     }
 
     template <class Archive>
-    void serialize(Archive& ar) const {
+    void serialize(Archive& ar) {
         ar(layers);
     }
 };
@@ -191,6 +206,16 @@ TEST_FN(tree1) {
         counter++;
     }
     CHECK_EQ(counter, 6);
+
+    // Generator sets are limited to one-byte span headers.
+    CHECK_EQ(circ::tree::Tree::from(vw::ints(0ul, 255ul)).layers[0].size(), 256);
+    CHECK_THROWS(circ::tree::Tree::from(vw::ints(0ul, 256ul)));
+    circ::tree::GroupedSpanBuilder wide;
+    wide.new_span();
+    for (auto i : vw::ints(0, 256)) {
+        wide.add(std::byte(i));
+    }
+    CHECK_THROWS(wide.new_span());
 }
 
 TEST_FN(tree2) {
@@ -1,7 +1,27 @@
-
+#include <charconv>
+#include <csignal>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <span>
+#include <string_view>
 #include "cereal/archives/binary.hpp"
+#include "clifford/batch.hpp"
+#include "clifford/count.hpp"
+#include "clifford/daemon.hpp"
+#include "clifford/depth.hpp"
+#include "clifford/estimate.hpp"
+#include "clifford/rules.hpp"
 #include "clifford/search.hpp"
+#include "clifford/state.hpp"
+#include "clifford/synthesis.hpp"
+
+namespace clfd::search {
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LayerCount, distance, classes, elements)
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LayerEstimate, distance, classes, classes_low, classes_high, elements, elements_low, elements_high, exact)
+}
 
 template <typename T>
 void save_binary(const std::string& filename, const T& obj) {
@@ -11,13 +31,341 @@ void save_binary(const std::string& filename, const T& obj) {
     archive(obj);
 }
 
+template <typename T>
+T load_binary(const std::string& filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) { throw std::runtime_error(fmt::format("Failed to open {}", filename)); }
+    cereal::BinaryInputArchive archive(ifs);
+    T obj;
+    archive(obj);
+    return obj;
+}
+
+void save_json(const std::string& filename, const nlohmann::json& json) {
+    std::ofstream ofs(filename);
+    if (!ofs) { throw std::runtime_error("Failed to open file for writing"); }
+    ofs << json.dump(2) << '\n';
+}
+
+template <std::size_t N>
+void clifsearch(clfd::search::SearchLimits limits) {
+    auto tree = clfd::search::search<N>(true, limits);
+    circ::tree::save_mapped(tree, fmt::format("result/clifford{}.tree.bin", N));
+    save_binary(fmt::format("result/clifford{}.index.cereal", N), clfd::search::SynthesisTable<N>::build(tree).index());
+}
+
 void clifsearch() {
-    save_binary("result/clifford2.tree.cereal", clfd::search::search<2>(true));
-    save_binary("result/clifford3.tree.cereal", clfd::search::search<3>(true));
+    clifsearch<2>({});
+    clifsearch<3>({});
+}
+
+template <std::size_t N>
+void clifsearch(std::string_view topology) {
+    auto graph = circ::CouplingGraph<N>::complete();
+    if (topology == "line") { graph = circ::CouplingGraph<N>::line(); }
+    if (topology == "ring") { graph = circ::CouplingGraph<N>::ring(); }
+    if (topology == "tee") {
+        graph = N == 4 ? circ::CouplingGraph<N>::from({{0, 1}, {1, 2}, {1, 3}}) : circ::CouplingGraph<N>::from({{0, 1}, {1, 2}, {1, 3}, {3, 4}});
+    }
+    save_binary(fmt::format("result/clifford{}.{}.tree.cereal", N, topology), clfd::search::search<N>(graph, true));
+}
+
+template <std::size_t N>
+void clifpaths() {
+    save_binary(fmt::format("result/clifford{}.paths.cereal", N), clfd::search::search_paths<N>(true));
+}
+
+template <std::size_t N>
+void clifdepth() {
+    save_binary(fmt::format("result/clifford{}.depth.cereal", N), clfd::search::search_depth<N>(true));
+}
+
+template <std::size_t N>
+void clifcount() {
+    auto layers = clfd::search::count<N>(true);
+    save_json(fmt::format("result/clifford{}.count.json", N), {{"n", N}, {"total", clfd::symplectic_matrix_count(N)}, {"layers", layers}});
+}
+
+// Estimates `count<N>` from a search truncated at `depth` and `samples` random matrices, in minutes instead of days.
+template <std::size_t N>
+void clifestimate(std::size_t samples, std::size_t depth) {
+    auto table = clfd::search::SynthesisTable<N>::build(clfd::search::search<N>(true, {.max_layers = depth}));
+    auto estimate = clfd::search::estimate_distances(table, samples);
+    auto [search_bytes, index_bytes] = estimate.template footprint<N>();
+    auto [search_bytes_high, index_bytes_high] = estimate.template footprint<N>(true);
+    fmt::println(stderr, "{} samples, {} beyond distance {}, search {:.3g} bytes (at most {:.3g}), index {:.3g} bytes (at most {:.3g})", samples,
+                 estimate.censored, 2 * table.max_distance(), search_bytes, search_bytes_high, index_bytes, index_bytes_high);
+    if (estimate.censored > 0) {
+        fmt::println(stderr, "warning: {} samples beyond distance {} are lumped into one tail layer; search deeper than {} to split it",
+                     estimate.censored, 2 * table.max_distance(), depth);
+    }
+    save_json(fmt::format("result/clifford{}.estimate.json", N), {{"n", N},
+                                                                 {"total", clfd::symplectic_matrix_count(N)},
+                                                                 {"samples", samples},
+                                                                 {"censored", estimate.censored},
+                                                                 {"layers", estimate.summary()},
+                                                                 {"intervals", estimate.layers},
+                                                                 {"tail", estimate.tail ? nlohmann::json(*estimate.tail) : nlohmann::json()},
+                                                                 {"search_bytes", search_bytes},
+                                                                 {"index_bytes", index_bytes}});
+}
+
+// Prefers the mapped tree, which the table keeps mapped after checking every layer once; trees saved through cereal by
+// older runs are still read.
+template <std::size_t N>
+clfd::search::SynthesisTable<N> load_table() {
+    auto entries = load_binary<std::vector<clfd::search::IndexEntry<N>>>(fmt::format("result/clifford{}.index.cereal", N));
+    if (auto path = fmt::format("result/clifford{}.tree.bin", N); std::filesystem::exists(path)) {
+        auto mapped = circ::tree::MappedTree(path);
+        if (!mapped.verify()) { throw std::runtime_error(fmt::format("{}: layer checksum mismatch", path)); }
+        return clfd::search::SynthesisTable<N>(std::move(mapped), std::move(entries));
+    }
+    return clfd::search::SynthesisTable<N>(load_binary<circ::tree::Tree>(fmt::format("result/clifford{}.tree.cereal", N)), std::move(entries));
+}
+
+// Saves the table as `result/clifford{N}.states.cereal` for `prepare`, next to the per-distance counts.
+template <std::size_t N>
+void clifstates() {
+    auto table = clfd::search::StatePrepTable<N>::build(true);
+    save_binary(fmt::format("result/clifford{}.states.cereal", N), table);
+    save_json(fmt::format("result/clifford{}.states.json", N), {{"n", N}, {"layers", table.layers()}});
+}
+
+// Reads one state per line from `input` ("-" for stdin) as N hexadecimal stabilizer generators, with bit q for X and bit
+// N + q for Z on qubit q, and writes `<cx count> | <gates>` preparing it from |0…0⟩, or `invalid`.
+template <std::size_t N>
+void clifprepare(std::string_view input) {
+    auto table = load_binary<clfd::search::StatePrepTable<N>>(fmt::format("result/clifford{}.states.cereal", N));
+    std::ifstream file;
+    if (input != "-") { file.open(std::string(input)); }
+    if (input != "-" && !file) { throw std::runtime_error(fmt::format("Failed to open {}", input)); }
+    auto& stream = input == "-" ? std::cin : file;
+    for (std::string line; std::getline(stream, line);) {
+        if (line.empty()) { continue; }
+        std::array<Bv<2 * N>, N> vectors;
+        const auto* it = line.data();
+        const auto* end = line.data() + line.size();
+        auto parsed = true;
+        for (auto& v : vectors) {
+            while (it != end && *it == ' ') { ++it; }
+            auto word = std::uint64_t(0);
+            auto [next, error] = std::from_chars(it, end, word, 16);
+            parsed = parsed && error == std::errc() && word < (std::uint64_t(1) << (2 * N));
+            v = Bv<2 * N>(word);
+            it = next;
+        }
+        auto state = parsed ? clfd::StabilizerState<N>::from_generators(vectors) : std::nullopt;
+        auto moves = state ? table.prepare(*state) : std::nullopt;
+        if (!moves) {
+            fmt::println("invalid");
+            continue;
+        }
+        auto cx = rgs::count_if(*moves, [](auto move) { return move.cost() > 0; });
+        auto gates = *moves | vw::transform([](auto move) { return std::visit([](auto&& g) { return g.fmt(); }, move.gate()); });
+        fmt::println("{} | {}", cx, fmt::join(gates, ", "));
+    }
+}
+
+// Reads targets from `input` ("-" for stdin) and writes one circuit per line to stdout; statistics go to stderr.
+template <std::size_t N>
+void clifbatch(std::string_view input, bool binary) {
+    auto table = load_table<N>();
+    std::ifstream file;
+    if (input != "-") { file.open(std::string(input), binary ? std::ios::binary : std::ios::in); }
+    if (input != "-" && !file) { throw std::runtime_error(fmt::format("Failed to open {}", input)); }
+    std::ios::sync_with_stdio(false);
+    auto stats = clfd::search::run_batch(table, input == "-" ? std::cin : file, std::cout, binary);
+    auto us = [&stats](double p) { return double(stats.percentile(p).count()) / 1000.0; };
+    fmt::println(stderr, "{} queries, {:.0f} queries/s, latency p50 {:.1f}us p90 {:.1f}us p99 {:.1f}us max {:.1f}us", stats.samples.size(),
+                 stats.throughput(), us(50), us(90), us(99), us(100));
+}
+
+// Mines `result/clifford{N}.rules.cereal` from the saved table, and optionally the same rules as readable JSON.
+template <std::size_t N>
+void clifrules(bool json) {
+    auto rules = clfd::search::RuleDatabase<N>::mine(load_table<N>());
+    save_binary(fmt::format("result/clifford{}.rules.cereal", N), rules);
+    fmt::println(stderr, "{} rules", rules.size());
+    if (!json) { return; }
+    auto gens = [](const std::vector<circ::CliffordGen<N>>& gens) {
+        auto result = nlohmann::json::array();
+        for (auto gen : gens) {
+            result.push_back({fmt::format("{}{}-CX", gen.op_ctrl(), gen.op_not()), gen.ictrl(), gen.inot()});
+        }
+        return result;
+    };
+    auto perm = [](circ::CircPerm perm) {
+        return vw::ints(QIdx(0), QIdx(N)) | vw::transform([perm](auto q) { return perm[q]; }) | rgs::to<std::vector>();
+    };
+    auto result = nlohmann::json::array();
+    for (auto i = 0ul; i < rules.size(); i++) {
+        auto rhs = rules.rhs(i);
+        result.push_back({{"old", gens(rules.lhs(i))},
+                          {"new", gens(rhs.gens)},
+                          {"left_perm", perm(rhs.left_perm)},
+                          {"left_sym", rhs.left_sym.data},
+                          {"right_perm", perm(rhs.right_perm)}});
+    }
+    save_json(fmt::format("result/clifford{}.equivalences.json", N), result);
+}
+
+// Serves every table found under `result/` on `socket` until SIGINT or SIGTERM. Trees saved as `.tree.bin` stay mapped,
+// so daemons and batch runs on one machine share their pages.
+void clifserve(std::string_view socket) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    auto daemon = clfd::protocol::Daemon(std::string(socket));
+    std::optional<clfd::search::SynthesisTable<2>> table2;
+    std::optional<clfd::search::SynthesisTable<3>> table3;
+    std::optional<clfd::search::SynthesisTable<4>> table4;
+    std::optional<clfd::search::SynthesisTable<5>> table5;
+    auto load = [&daemon]<std::size_t N>(std::optional<clfd::search::SynthesisTable<N>>& table) {
+        if (!std::filesystem::exists(fmt::format("result/clifford{}.index.cereal", N))) { return; }
+        daemon.add(table.emplace(load_table<N>()));
+        fmt::println(stderr, "loaded {}-qubit table", N);
+    };
+    load(table2);
+    load(table3);
+    load(table4);
+    load(table5);
+
+    auto waiter = std::thread([&daemon, &signals] {
+        int signal = 0;
+        sigwait(&signals, &signal);
+        daemon.stop();
+    });
+    fmt::println(stderr, "listening on {}", socket);
+    daemon.serve();
+    waiter.join();
+    auto stats = daemon.stats();
+    fmt::println(stderr, "{} requests, {} queries, latency p50 {}ns p99 {}ns", stats.requests, stats.queries, stats.p50_ns, stats.p99_ns);
+}
+
+// A whole argument as a number, or nothing so that bad input falls through to the usage message.
+std::optional<std::size_t> parse_count(std::string_view arg) {
+    auto value = 0ul;
+    auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    if (error != std::errc() || end != arg.data() + arg.size()) { return std::nullopt; }
+    return value;
 }
 
-int main(int /*argc*/, char** /*argv*/) {
+int main(int argc, char** argv) {
+    auto args = std::span(argv, std::size_t(argc)) | vw::transform([](auto arg) { return std::string_view(arg); }) | rgs::to<std::vector>();
+    if (args.size() == 3 && args[1] == "count") {
+        switch (parse_count(args[2]).value_or(0)) {
+            case 2: clifcount<2>(); return 0;
+            case 3: clifcount<3>(); return 0;
+            case 4: clifcount<4>(); return 0;
+            case 5: clifcount<5>(); return 0;
+            default: break;
+        }
+    }
+    if (args.size() == 3 && args[1] == "paths") {
+        switch (parse_count(args[2]).value_or(0)) {
+            case 2: clifpaths<2>(); return 0;
+            case 3: clifpaths<3>(); return 0;
+            case 4: clifpaths<4>(); return 0;
+            case 5: clifpaths<5>(); return 0;
+            default: break;
+        }
+    }
+    if (args.size() == 3 && args[1] == "depth") {
+        switch (parse_count(args[2]).value_or(0)) {
+            case 2: clifdepth<2>(); return 0;
+            case 3: clifdepth<3>(); return 0;
+            case 4: clifdepth<4>(); return 0;
+            case 5: clifdepth<5>(); return 0;
+            default: break;
+        }
+    }
+    if (args.size() >= 3 && args.size() <= 5 && args[1] == "estimate") {
+        auto samples = args.size() >= 4 ? parse_count(args[3]) : 10000ul;
+        auto depth = args.size() >= 5 ? parse_count(args[4]) : 3ul;
+        switch (samples && depth ? parse_count(args[2]).value_or(0) : 0) {
+            case 2: clifestimate<2>(*samples, *depth); return 0;
+            case 3: clifestimate<3>(*samples, *depth); return 0;
+            case 4: clifestimate<4>(*samples, *depth); return 0;
+            case 5: clifestimate<5>(*samples, *depth); return 0;
+            default: break;
+        }
+    }
+    if (args.size() == 3 && args[1] == "states") {
+        switch (parse_count(args[2]).value_or(0)) {
+            case 2: clifstates<2>(); return 0;
+            case 3: clifstates<3>(); return 0;
+            case 4: clifstates<4>(); return 0;
+            case 5: clifstates<5>(); return 0;
+            case 6: clifstates<6>(); return 0;
+            default: break;
+        }
+    }
+    if ((args.size() == 3 || args.size() == 4) && args[1] == "prepare") {
+        auto input = args.size() == 4 ? args[3] : std::string_view("-");
+        switch (parse_count(args[2]).value_or(0)) {
+            case 2: clifprepare<2>(input); return 0;
+            case 3: clifprepare<3>(input); return 0;
+            case 4: clifprepare<4>(input); return 0;
+            case 5: clifprepare<5>(input); return 0;
+            case 6: clifprepare<6>(input); return 0;
+            default: break;
+        }
+    }
+    if (args.size() == 4 && args[1] == "coupling" && (args[3] == "line" || args[3] == "ring" || args[3] == "tee")) {
+        switch (parse_count(args[2]).value_or(0)) {
+            case 4: clifsearch<4>(args[3]); return 0;
+            case 5: clifsearch<5>(args[3]); return 0;
+            default: break;
+        }
+    }
+    if (args.size() >= 3 && args.size() <= 6 && args[1] == "search") {
+        auto limit = [&args](std::size_t i) { return i < args.size() ? parse_count(args[i]) : std::numeric_limits<std::size_t>::max(); };
+        auto valid = limit(3) && limit(4) && limit(5);
+        auto limits = clfd::search::SearchLimits{
+            .max_layers = limit(3).value_or(0), .max_classes = limit(4).value_or(0), .max_bytes = limit(5).value_or(0)
+        };
+        switch (valid ? parse_count(args[2]).value_or(0) : 0) {
+            case 4: clifsearch<4>(limits); return 0;
+            case 5: clifsearch<5>(limits); return 0;
+            default: break;
+        }
+    }
+    if (args.size() >= 3 && args.size() <= 5 && args[1] == "batch" && (args.size() < 5 || args[4] == "binary")) {
+        auto input = args.size() >= 4 ? args[3] : std::string_view("-");
+        switch (parse_count(args[2]).value_or(0)) {
+            case 2: clifbatch<2>(input, args.size() == 5); return 0;
+            case 3: clifbatch<3>(input, args.size() == 5); return 0;
+            case 4: clifbatch<4>(input, args.size() == 5); return 0;
+            case 5: clifbatch<5>(input, args.size() == 5); return 0;
+            default: break;
+        }
+    }
+    if ((args.size() == 3 || (args.size() == 4 && args[3] == "json")) && args[1] == "rules") {
+        switch (parse_count(args[2]).value_or(0)) {
+            case 2: clifrules<2>(args.size() == 4); return 0;
+            case 3: clifrules<3>(args.size() == 4); return 0;
+            case 4: clifrules<4>(args.size() == 4); return 0;
+            case 5: clifrules<5>(args.size() == 4); return 0;
+            default: break;
+        }
+    }
+    if (args.size() == 3 && args[1] == "serve") {
+        clifserve(args[2]);
+        return 0;
+    }
+    if (args.size() > 1) {
+        fmt::println(
+            stderr,
+            "usage: {} [count <2..5> | paths <2..5> | depth <2..5> | estimate <2..5> [samples [depth]] | states <2..6> | "
+            "prepare <2..6> [input|-] | coupling <4..5> <line|ring|tee> | search <4..5> [max_layers [max_classes [max_bytes]]] | "
+            "batch <2..5> [input|- [binary]] | rules <2..5> [json] | serve <socket>]",
+            args[0]
+        );
+        return 1;
+    }
     clifsearch();
-    // clifsearch<5>();
     return 0;
 }
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./greedy.hpp"
+#include "./synthesis.hpp"
+
+namespace clfd::search {
+
+// Per-query latencies, reported as percentiles.
+struct LatencyStats {
+    std::vector<std::chrono::nanoseconds> samples;
+    std::chrono::steady_clock::duration wall{};
+
+    [[nodiscard]] inline std::chrono::nanoseconds percentile(double p) {
+        if (samples.empty()) { return {}; }
+        auto k = std::min(samples.size() - 1, std::size_t(p / 100.0 * double(samples.size())));
+        std::ranges::nth_element(samples, samples.begin() + std::ptrdiff_t(k));
+        return samples[k];
+    }
+    [[nodiscard]] inline double throughput() const noexcept {
+        return double(samples.size()) / std::chrono::duration<double>(wall).count();
+    }
+};
+
+// A target in the raw layout of `BitSymplectic<N>::as_raw()`: x rows and z rows as two hex numbers on one line, or as
+// two native 64-bit words per binary record. Anything that is not a symplectic matrix is rejected.
+template <std::size_t N>
+[[nodiscard]] inline std::optional<BitSymplectic<N>> parse_target(std::uint64_t xrows, std::uint64_t zrows) noexcept {
+    using Rows = Bv<N * 2 * N>;
+    if (xrows > Rows::MASK || zrows > Rows::MASK) { return std::nullopt; }
+    auto row = [](std::uint64_t rows, std::size_t i) { return Bv<2 * N>::slice(Rows(rows), i * 2 * N); };
+    for (auto i = 0ul; i < N; i++) {
+        for (auto j = 0ul; j < N; j++) {
+            if (BitSymplectic<N>::omega(row(xrows, i), row(zrows, j)) != (i == j) || BitSymplectic<N>::omega(row(xrows, i), row(xrows, j)) ||
+                BitSymplectic<N>::omega(row(zrows, i), row(zrows, j))) {
+                return std::nullopt;
+            }
+        }
+    }
+    return BitSymplectic<N>::raw(Rows(xrows), Rows(zrows));
+}
+template <std::size_t N>
+[[nodiscard]] inline std::optional<BitSymplectic<N>> parse_target(std::string_view line) noexcept {
+    std::uint64_t raw[2];
+    const auto* it = line.data();
+    const auto* end = line.data() + line.size();
+    for (auto& word : raw) {
+        while (it != end && *it == ' ') { ++it; }
+        auto [next, error] = std::from_chars(it, end, word, 16);
+        if (error != std::errc()) { return std::nullopt; }
+        it = next;
+    }
+    return parse_target<N>(raw[0], raw[1]);
+}
+
+// `<cx count> | <gates> | <final relabeling>`, `none` when the table does not reach the target, `invalid` when it did
+// not parse.
+template <std::size_t N>
+[[nodiscard]] inline std::string format_result(const std::optional<BitSymplectic<N>>& target, const std::optional<Synthesis<N>>& synthesis) {
+    if (!target) { return "invalid"; }
+    if (!synthesis) { return "none"; }
+    auto circuit = synthesis_circuit(*synthesis);
+    std::string result = std::to_string(synthesis->gens.size()) + " |";
+    for (auto i = 0ul; i < circuit.gates.size(); i++) {
+        result += (i == 0 ? " " : ", ") + std::visit([](auto&& g) { return g.fmt(); }, circuit.gates[i]);
+    }
+    result += " |";
+    for (auto q : circuit.perm) {
+        result += " " + std::to_string(q);
+    }
+    return result;
+}
+
+// Synthesizes a stream of targets on `nthreads` workers. Input is read in batches of `batch` queries, so results are
+// written in input order while at most one batch is held in memory.
+template <std::size_t N>
+inline LatencyStats run_batch(const SynthesisTable<N>& table, std::istream& input, std::ostream& output, bool binary,
+                              std::size_t nthreads = std::thread::hardware_concurrency(), std::size_t batch = 4096) {
+    LatencyStats stats;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::optional<BitSymplectic<N>>> targets;
+    std::vector<std::string> results;
+    std::vector<std::chrono::nanoseconds> latencies;
+    for (auto done = false; !done;) {
+        targets.clear();
+        std::string line;
+        while (targets.size() < batch) {
+            if (binary) {
+                std::uint64_t raw[2];
+                if (!input.read(reinterpret_cast<char*>(raw), sizeof(raw))) { break; }  // NOLINT
+                targets.push_back(parse_target<N>(raw[0], raw[1]));
+            } else {
+                if (!std::getline(input, line)) { break; }
+                if (line.empty()) { continue; }
+                targets.push_back(parse_target<N>(line));
+            }
+        }
+        done = targets.size() < batch;
+
+        results.assign(targets.size(), {});
+        latencies.assign(targets.size(), {});
+        auto next = std::atomic<std::size_t>(0);
+        auto worker = [&] {
+            for (auto i = next++; i < targets.size(); i = next++) {
+                auto begin = std::chrono::steady_clock::now();
+                results[i] = format_result(targets[i], targets[i] ? table.synthesize(*targets[i]) : std::nullopt);
+                latencies[i] = std::chrono::steady_clock::now() - begin;
+            }
+        };
+        std::vector<std::thread> threads;
+        for (auto i = 1ul; i < std::min(nthreads, targets.size()); i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& result : results) {
+            output << result << '\n';
+        }
+        output.flush();
+        stats.samples.insert(stats.samples.end(), latencies.begin(), latencies.end());
+    }
+    stats.wall = std::chrono::steady_clock::now() - start;
+    return stats;
+}
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(run_batch) {
+    auto table = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>(false, {.max_layers = 3}));
+    std::vector<clfd::BitSymplectic<3>> targets;
+    std::stringstream text, binary;
+    for (auto i = 0ul; i < 300ul; i++) {
+        auto target = clfd::BitSymplectic<3>::identity();
+        perform_random_gates(target, 20, clfd::CliffordGate<3>::all_gates(), Bv<2>(0b11));
+        targets.push_back(target);
+        auto [x, z] = target.as_raw();
+        char buffer[40];
+        auto* end = std::to_chars(buffer, buffer + 20, x, 16).ptr;
+        *end++ = ' ';
+        end = std::to_chars(end, buffer + 40, z, 16).ptr;
+        text << std::string_view(buffer, end) << '\n';
+        binary.write(reinterpret_cast<const char*>(&x), sizeof(x));
+        binary.write(reinterpret_cast<const char*>(&z), sizeof(z));
+    }
+    text << "0 0\nnot a matrix\n";
+
+    std::stringstream text_out, binary_out;
+    auto stats = clfd::search::run_batch(table, text, text_out, false, 4, 64);
+    CHECK_EQ(stats.samples.size(), 302);
+    CHECK(stats.percentile(50) <= stats.percentile(99));
+    clfd::search::run_batch(table, binary, binary_out, true, 3, 100);
+
+    std::string line, binary_line;
+    for (auto target : targets) {
+        std::getline(text_out, line);
+        std::getline(binary_out, binary_line);
+        CHECK_EQ(line, binary_line);
+        auto synthesis = table.synthesize(target);
+        CHECK_EQ(line, clfd::search::format_result<3>(target, synthesis));
+        CHECK_EQ(line == "none", !synthesis.has_value());
+    }
+    std::getline(text_out, line);
+    CHECK_EQ(line, "invalid");
+    std::getline(text_out, line);
+    CHECK_EQ(line, "invalid");
+}
+// NOLINTEND
@@ -307,6 +307,36 @@ class BitSymplectic {
     }
     [[nodiscard]] inline constexpr std::size_t count_ones() const noexcept { return xrows.count_ones() + zrows.count_ones(); }
 
+    // Matrix product `*this · rhs`, so that `g * m == m.identity().mul_l(g).multiply(m)`.
+    [[nodiscard]] inline constexpr BitSymplectic<N> multiply(const BitSymplectic<N>& rhs) const noexcept {
+        auto result = BitSymplectic<N>(0ul, 0ul);
+        for (auto k = 0ul; k < VecN; k++) {
+            auto row = k < N ? rhs.xrow(k) : rhs.zrow(k - N);
+            for (auto i = 0ul; i < N; i++) {
+                if (xrow(i)[k]) { result.xor_xrow(i, row); }
+                if (zrow(i)[k]) { result.xor_zrow(i, row); }
+            }
+        }
+        assert(result.check_symplecticity());
+        return result;
+    }
+    // Symplectic inverse `Ω Mᵀ Ω`.
+    [[nodiscard]] inline constexpr BitSymplectic<N> inverse() const noexcept {
+        auto result = BitSymplectic<N>(0ul, 0ul);
+        for (auto i = 0ul; i < VecN; i++) {
+            for (auto j = 0ul; j < VecN; j++) {
+                if (!get((j + N) % VecN, (i + N) % VecN)) { continue; }
+                if (i < N) {
+                    result.xor_xrow(i, Bv<VecN>(1ul) << j);
+                } else {
+                    result.xor_zrow(i - N, Bv<VecN>(1ul) << j);
+                }
+            }
+        }
+        assert(result.check_symplecticity());
+        return result;
+    }
+
     inline static const auto MASK_XCOLS = Bv<2 * N * N>(repeat_row<2 * N, N>(n_ones(N)));
     inline static const auto MASK_ZCOLS = Bv<2 * N * N>(repeat_row<2 * N, N>(n_ones(N) << N));
     [[nodiscard]] inline constexpr Bv<2 * N * N> kappa() const noexcept {
@@ -345,6 +375,11 @@ template <std::size_t N, typename GateT>
     return matrix.mul_l(gate);
 }
 
+template <std::size_t N>
+[[nodiscard]] inline constexpr clfd::BitSymplectic<N> operator*(const clfd::BitSymplectic<N>& lhs, const clfd::BitSymplectic<N>& rhs) noexcept {
+    return lhs.multiply(rhs);
+}
+
 template <std::size_t N>
 struct std::hash<clfd::BitSymplectic<N>> {  // NOLINT
     std::size_t operator()(const clfd::BitSymplectic<N>& s) const noexcept {
@@ -438,4 +473,15 @@ TEST_FN(testing_cnot) {
     matrix.do_hadamard_r(3ul);
     CHECK_EQ(matrix, clfd::BitSymplectic<5ul>::identity());
 }
+
+TEST_FN(testing_multiply) {
+    const auto identity = clfd::BitSymplectic<4ul>::identity();
+    auto a = identity.cnot_l(0ul, 1ul).hadamard_l(2ul).phase_l(1ul).cnot_l(3ul, 2ul).hadamard_l(0ul);
+    auto b = identity.phase_l(3ul).cnot_l(2ul, 0ul).hadamard_l(1ul).cnot_l(1ul, 3ul);
+    CHECK_EQ(a * b, b.cnot_l(0ul, 1ul).hadamard_l(2ul).phase_l(1ul).cnot_l(3ul, 2ul).hadamard_l(0ul));
+    CHECK_EQ(b * a, b.hadamard_r(0ul).cnot_r(3ul, 2ul).phase_r(1ul).hadamard_r(2ul).cnot_r(0ul, 1ul));
+    CHECK_EQ(a * a.inverse(), identity);
+    CHECK_EQ(b.inverse() * b, identity);
+    CHECK_EQ((a * b).inverse(), b.inverse() * a.inverse());
+}
 // NOLINTEND
\ No newline at end of file
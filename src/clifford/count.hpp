@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../table/bsearch_vec.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./gate.hpp"
+#include "reduce/quick.hpp"
+
+namespace clfd::search {
+
+struct LayerCount {
+    std::size_t distance;
+    std::size_t classes;
+    std::size_t elements;
+};
+
+// Counting-only variant of `search<N>`: no tree is built and only the last three layers of canonical forms are kept.
+// Nodes are expanded from their canonical representative instead of a replayed path, since every member of a class
+// reaches the same set of classes in one step.
+template <std::size_t N>
+std::vector<LayerCount> count(bool verbose = false) {  // NOLINT
+    auto all_gen = circ::CliffordGen<N>::all_generator();
+    auto last2_layer = std::vector<BitSymplectic<N>>();
+    auto last_layer = std::vector<BitSymplectic<N>>{quick_reduce(BitSymplectic<N>::identity())};
+    auto result = std::vector<LayerCount>{{0, 1, quick_reduce_eqcount(last_layer.front())}};
+    auto symplectic_count = result.front().elements;
+    auto symplectic_count_total = symplectic_matrix_count(N);
+
+    for (auto distance = 1ul;; distance++) {
+        table::BSearchVec<BitSymplectic<N>> bsvec;
+        auto layer = LayerCount{distance, 0, 0};
+
+        for (auto node : last_layer) {
+            for (auto gen : all_gen) {
+                auto reduced_result = quick_reduce(gen * node);
+                if (std::binary_search(last_layer.begin(), last_layer.end(), reduced_result)) { continue; }
+                if (std::binary_search(last2_layer.begin(), last2_layer.end(), reduced_result)) { continue; }
+                if (bsvec.contains(reduced_result)) { continue; }
+                bsvec.insert(reduced_result);
+                layer.classes += 1;
+                layer.elements += quick_reduce_eqcount(reduced_result);
+            }
+        }
+
+        if (layer.classes == 0) { break; }
+        symplectic_count += layer.elements;
+        result.push_back(layer);
+        if (verbose) {
+            fmt::println("Counting Symplectic<{}>: distance {} classes {} elements {} ({}/{})", N, distance, layer.classes, layer.elements,
+                         symplectic_count, symplectic_count_total);
+        }
+
+        last2_layer = std::move(last_layer);
+        last_layer = bsvec.build_sorted();
+    }
+
+    assert(symplectic_count == symplectic_count_total);
+    return result;
+}
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(search_count) {
+    auto total = [](auto&& layers) { return rgs::accumulate(layers | vw::transform([](auto&& layer) { return layer.elements; }), 0ul); };
+    auto layers2 = clfd::search::count<2>();
+    CHECK_EQ(layers2.size(), 2);
+    CHECK_EQ(total(layers2), clfd::symplectic_matrix_count(2));
+    auto layers3 = clfd::search::count<3>();
+    CHECK_EQ(layers3.size(), 5);
+    CHECK_EQ(layers3[2].classes, 72);
+    CHECK_EQ(total(layers3), clfd::symplectic_matrix_count(3));
+}
+// NOLINTEND
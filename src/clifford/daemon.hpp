@@ -0,0 +1,293 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "./batch.hpp"
+#include "./protocol.hpp"
+#include "./synthesis.hpp"
+#include "reduce/quick.hpp"
+
+namespace clfd::protocol {
+
+// Request latencies in power-of-two buckets, recorded without locks by every connection.
+class LatencyHistogram {
+    std::array<std::atomic<std::uint64_t>, 64> buckets{};
+    std::atomic<std::uint64_t> queries{0};
+
+   public:
+    inline void add(std::chrono::nanoseconds latency, std::size_t count) noexcept {
+        buckets[std::bit_width(std::uint64_t(std::max(latency.count(), 1l)) - 1)] += 1;
+        queries += count;
+    }
+    [[nodiscard]] inline StatsRecord snapshot() const noexcept {
+        std::array<std::uint64_t, 64> counts{};
+        auto total = 0ul;
+        for (auto i = 0ul; i < counts.size(); i++) {
+            counts[i] = buckets[i].load();
+            total += counts[i];
+        }
+        auto percentile = [&](double p) {
+            auto seen = 0ul;
+            for (auto i = 0ul; i < counts.size(); i++) {
+                seen += counts[i];
+                if (seen > 0 && double(seen) >= p / 100.0 * double(total)) { return std::uint64_t(1) << i; }
+            }
+            return std::uint64_t(0);
+        };
+        return {.requests = total, .queries = queries.load(), .p50_ns = percentile(50), .p90_ns = percentile(90), .p99_ns = percentile(99),
+                .max_ns = percentile(100)};
+    }
+};
+
+// Serves distance and synthesis queries against resident tables over a Unix-domain socket, one thread per connection.
+// Tables are borrowed, normally loaded mapped so that daemons share their pages; sizes without a table answer
+// `Status::NoTable`. A connection closes its socket and leaves the list as soon as its handler returns.
+class Daemon {
+    static constexpr std::uint32_t MAX_BATCH = 1u << 20;
+
+    struct Connection {
+        int fd;
+        std::thread thread;
+    };
+
+    std::string path;
+    int listener;
+    std::tuple<const search::SynthesisTable<2>*, const search::SynthesisTable<3>*, const search::SynthesisTable<4>*,
+               const search::SynthesisTable<5>*>
+        tables{};
+    LatencyHistogram latencies;
+    std::atomic<bool> stopping = false;
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::list<Connection> connections;
+
+   public:
+    inline explicit Daemon(std::string path) : path(std::move(path)), listener(::socket(AF_UNIX, SOCK_STREAM, 0)) {
+        if (listener < 0) { throw std::system_error(errno, std::generic_category(), "socket"); }
+        auto address = socket_address(this->path);
+        ::unlink(this->path.c_str());
+        if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listener, 64) < 0) {  // NOLINT
+            auto error = errno;
+            ::close(listener);
+            throw std::system_error(error, std::generic_category(), "bind " + this->path);
+        }
+    }
+    inline ~Daemon() {
+        stop();
+        wait();
+        ::close(listener);
+        ::unlink(path.c_str());
+    }
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    template <std::size_t N>
+    inline void add(const search::SynthesisTable<N>& table) noexcept {
+        std::get<const search::SynthesisTable<N>*>(tables) = &table;
+    }
+    [[nodiscard]] inline StatsRecord stats() const noexcept { return latencies.snapshot(); }
+    [[nodiscard]] inline std::size_t nconnections() noexcept {
+        std::scoped_lock lock(mutex);
+        return connections.size();
+    }
+
+    // Accepts connections until `stop()`.
+    inline void serve() {
+        while (!stopping) {
+            auto fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) { continue; }
+                if (stopping) { break; }
+                throw std::system_error(errno, std::generic_category(), "accept");
+            }
+            std::scoped_lock lock(mutex);
+            auto& connection = connections.emplace_back();
+            connection.fd = fd;
+            connection.thread = std::thread([this, &connection] {
+                handle(connection.fd);
+                finish(connection);
+            });
+        }
+        wait();
+    }
+    // Safe to call from any thread; wakes `serve()` and every blocked connection.
+    inline void stop() noexcept {
+        stopping = true;
+        ::shutdown(listener, SHUT_RDWR);
+        std::scoped_lock lock(mutex);
+        for (auto& connection : connections) {
+            ::shutdown(connection.fd, SHUT_RDWR);
+        }
+    }
+
+   private:
+    // Runs last on the connection's own thread, which cannot join itself, so it detaches; `wait()` then stands in for
+    // the join. `serve()` holds the lock while it starts the thread, so `connection.thread` is set by now.
+    inline void finish(Connection& connection) noexcept {
+        std::scoped_lock lock(mutex);
+        ::close(connection.fd);
+        connection.thread.detach();
+        connections.remove_if([&connection](const Connection& other) { return &other == &connection; });
+        if (connections.empty()) { idle.notify_all(); }
+    }
+    inline void wait() {
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this] { return connections.empty(); });
+    }
+
+    inline void handle(int fd) noexcept {
+        try {
+            std::vector<std::uint64_t> raw;
+            std::vector<std::byte> payload;
+            while (!stopping) {
+                RequestHeader request;
+                read_full(fd, &request, sizeof(request));
+                auto begin = std::chrono::steady_clock::now();
+                ResponseHeader response{.kind = request.kind, .status = Status::Ok, .count = request.count, .bytes = 0};
+                if (request.magic != MAGIC || request.count > MAX_BATCH) {
+                    response.status = Status::BadRequest;
+                    write_full(fd, &response, sizeof(response));
+                    return;
+                }
+                raw.resize(2 * std::size_t(request.count));
+                read_full(fd, raw.data(), raw.size() * sizeof(std::uint64_t));
+
+                payload.clear();
+                if (request.kind == Kind::Stats) {
+                    append(payload, latencies.snapshot());
+                } else {
+                    response.status = dispatch(request, raw, payload);
+                }
+                response.bytes = std::uint32_t(payload.size());
+                write_full(fd, &response, sizeof(response));
+                write_full(fd, payload.data(), payload.size());
+                latencies.add(std::chrono::steady_clock::now() - begin, request.count);
+            }
+        } catch (const std::system_error&) {
+            // The client went away or the daemon is stopping.
+        }
+    }
+
+    [[nodiscard]] inline Status dispatch(const RequestHeader& request, const std::vector<std::uint64_t>& raw, std::vector<std::byte>& payload) const {
+        switch (request.nqubits) {
+            case 2: return answer(std::get<0>(tables), request.kind, raw, payload);
+            case 3: return answer(std::get<1>(tables), request.kind, raw, payload);
+            case 4: return answer(std::get<2>(tables), request.kind, raw, payload);
+            case 5: return answer(std::get<3>(tables), request.kind, raw, payload);
+            default: return Status::BadRequest;
+        }
+    }
+
+    template <std::size_t N>
+    [[nodiscard]] inline static Status answer(const search::SynthesisTable<N>* table, Kind kind, const std::vector<std::uint64_t>& raw,
+                                              std::vector<std::byte>& payload) {
+        if (table == nullptr) { return Status::NoTable; }
+        if (kind != Kind::Distance && kind != Kind::Synthesize) { return Status::BadRequest; }
+        for (auto i = 0ul; i < raw.size(); i += 2) {
+            auto target = search::parse_target<N>(raw[i], raw[i + 1]);
+            if (!target) {
+                append(payload, INVALID);
+            } else if (kind == Kind::Distance) {
+                const auto* entry = table->find(quick_reduce(*target));
+                append(payload, entry == nullptr ? NOT_FOUND : std::uint8_t(table->distance(*entry)));
+            } else if (auto synthesis = table->synthesize(*target)) {
+                encode_synthesis(payload, *synthesis);
+            } else {
+                append(payload, NOT_FOUND);
+            }
+        }
+        return Status::Ok;
+    }
+};
+
+}  // namespace clfd::protocol
+
+// NOLINTBEGIN
+TEST_FN(daemon) {
+    auto tree = clfd::search::search<3>(false, {.max_layers = 3});
+    auto tree_path = "/tmp/clifford-daemon-test-" + std::to_string(::getpid()) + ".bin";
+    circ::tree::save_mapped(tree, tree_path);
+    auto table = clfd::search::SynthesisTable<3>(circ::tree::MappedTree(tree_path), clfd::search::SynthesisTable<3>::build(tree).index());
+    ::unlink(tree_path.c_str());
+    auto path = "/tmp/clifford-daemon-test-" + std::to_string(::getpid()) + ".sock";
+    // A depth table answers depths, and its circuits put at most two generators in each step.
+    auto depth_table = clfd::search::SynthesisTable<2>::build(clfd::search::search_depth<2>());
+    auto daemon = clfd::protocol::Daemon(path);
+    daemon.add(table);
+    daemon.add(depth_table);
+    auto server = std::thread([&daemon] { daemon.serve(); });
+
+    std::vector<clfd::BitSymplectic<3>> targets;
+    for (auto i = 0ul; i < 200ul; i++) {
+        auto target = clfd::BitSymplectic<3>::identity();
+        perform_random_gates(target, 20, clfd::CliffordGate<3>::all_gates(), Bv<2>(0b11));
+        targets.push_back(target);
+    }
+    {
+        auto client = clfd::protocol::Client(path);
+        auto other = clfd::protocol::Client(path);
+        auto distances = client.distance<3>(targets);
+        auto circuits = other.synthesize<3>(targets);
+        CHECK_EQ(distances.size(), targets.size());
+        CHECK_EQ(circuits.size(), targets.size());
+        for (auto i = 0ul; i < targets.size(); i++) {
+            const auto* entry = table.find(clfd::quick_reduce(targets[i]));
+            CHECK_EQ(distances[i], entry == nullptr ? clfd::protocol::NOT_FOUND : table.distance(*entry));
+            CHECK_EQ(circuits[i].has_value(), entry != nullptr);
+            if (circuits[i]) {
+                CHECK_EQ(circuits[i]->matrix(), targets[i]);
+                CHECK_EQ(circuits[i]->gens.size(), distances[i]);
+            }
+        }
+        CHECK_THROWS(client.distance<4>(std::vector{clfd::BitSymplectic<4>::identity()}));
+
+        auto stats = other.stats();
+        CHECK_EQ(stats.requests, 3);
+        CHECK_EQ(stats.queries, 2 * targets.size() + 1);
+        CHECK(stats.p50_ns <= stats.max_ns);
+
+        std::vector<clfd::BitSymplectic<2>> pairs;
+        for (auto i = 0ul; i < 100ul; i++) {
+            auto target = clfd::BitSymplectic<2>::identity();
+            perform_random_gates(target, 20, clfd::CliffordGate<2>::all_gates(), Bv<2>(0b11));
+            pairs.push_back(target);
+        }
+        auto depth_client = clfd::protocol::Client(path);
+        auto depths = depth_client.distance<2>(pairs);
+        auto depth_circuits = depth_client.synthesize<2>(pairs);
+        for (auto i = 0ul; i < pairs.size(); i++) {
+            const auto* entry = depth_table.find(clfd::quick_reduce(pairs[i]));
+            CHECK(entry != nullptr);
+            CHECK_EQ(depths[i], depth_table.distance(*entry));
+            CHECK(depth_circuits[i].has_value());
+            if (depth_circuits[i]) {
+                CHECK_EQ(depth_circuits[i]->matrix(), pairs[i]);
+                CHECK(depths[i] <= depth_circuits[i]->gens.size() && depth_circuits[i]->gens.size() <= 2 * depths[i]);
+            }
+        }
+    }
+    // Closed connections are reaped by their own threads, without waiting for another client.
+    for (auto i = 0; i < 1000 && daemon.nconnections() > 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK_EQ(daemon.nconnections(), 0);
+    daemon.stop();
+    server.join();
+}
+// NOLINTEND
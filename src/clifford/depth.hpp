@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/tree/tree.hpp"
+#include "../table/bsearch_vec.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./gate.hpp"
+#include "reduce/quick.hpp"
+
+namespace clfd::search {
+
+// Result of `search_depth<N>`. A depth step takes two tree layers: the first holds `g1`, the second either `g2 > g1`
+// disjoint from it or `g1` again for a single-generator step. Nodes must be read through `decode`; replaying the bytes
+// one generator per layer, as `search<N>` trees are, would apply the repeated `g1` twice.
+template <std::size_t N>
+struct DepthTree {
+    circ::tree::Tree tree;
+
+    [[nodiscard]] inline std::size_t depth() const noexcept { return tree.nlayers() / 2; }
+
+    // Generator bytes of a path through whole steps, first applied first.
+    [[nodiscard]] inline static std::vector<std::byte> decode(std::span<const std::byte> path) {
+        assert(path.size() % 2 == 0);
+        std::vector<std::byte> gens;
+        for (auto i = 0ul; i < path.size(); i += 2) {
+            gens.push_back(path[i]);
+            if (path[i + 1] != path[i]) { gens.push_back(path[i + 1]); }
+        }
+        return gens;
+    }
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(tree);
+    }
+};
+
+// Depth-optimal counterpart of `search<N>`: one step is a layer of generators on disjoint qubit pairs, and for N <= 5 a
+// layer holds at most two generators. Stops after `max_depth` steps.
+template <std::size_t N>
+DepthTree<N> search_depth(bool verbose = false, std::size_t max_depth = std::numeric_limits<std::size_t>::max()) {  // NOLINT
+    static_assert(N <= 5, "Parallel layers are encoded as at most two generators");
+    auto all_gen = circ::CliffordGen<N>::all_generator();
+    auto tree = circ::tree::Tree();
+    auto last2_layer = std::vector<BitSymplectic<N>>();
+    auto last_layer = std::vector<BitSymplectic<N>>{quick_reduce(BitSymplectic<N>::identity())};
+    auto symplectic_count = quick_reduce_eqcount(last_layer.front());
+    auto symplectic_count_total = symplectic_matrix_count(N);
+
+    for (auto depth = 1ul; depth <= max_depth; depth++) {
+        table::BSearchVec<BitSymplectic<N>> bsvec;
+        circ::tree::GroupedSpanBuilder first_builder;
+        circ::tree::GroupedSpanBuilder second_builder;
+        std::vector<std::byte> seconds;
+
+        auto expand = [&](BitSymplectic<N> result) {
+            first_builder.new_span();
+            for (auto g1 : vw::ints(0ul, all_gen.size())) {
+                auto with_g1 = all_gen[g1] * result;
+                seconds.clear();
+                for (auto g2 : vw::ints(g1, all_gen.size())) {
+                    if (g2 != g1 && !all_gen[g2].disjoint(all_gen[g1])) { continue; }
+                    auto reduced_result = quick_reduce(g2 == g1 ? with_g1 : all_gen[g2] * with_g1);
+                    if (std::binary_search(last_layer.begin(), last_layer.end(), reduced_result)) { continue; }
+                    if (std::binary_search(last2_layer.begin(), last2_layer.end(), reduced_result)) { continue; }
+                    if (bsvec.contains(reduced_result)) { continue; }
+                    bsvec.insert(reduced_result);
+                    seconds.push_back(circ::tree::node_byte(g2));
+                    symplectic_count += quick_reduce_eqcount(reduced_result);
+                }
+                if (seconds.empty()) { continue; }
+                first_builder.add(circ::tree::node_byte(g1));
+                second_builder.new_span();
+                for (auto g2 : seconds) {
+                    second_builder.add(g2);
+                }
+            }
+        };
+
+        if (tree.nlayers() == 0) {
+            expand(BitSymplectic<N>::identity());
+        } else {
+            for (auto node : tree) {
+                auto result = BitSymplectic<N>::identity();
+                for (auto i = 0ul; i < node.size(); i += 2) {
+                    result = all_gen[std::size_t(*node[i])] * result;
+                    if (*node[i + 1] != *node[i]) { result = all_gen[std::size_t(*node[i + 1])] * result; }
+                }
+                expand(result);
+            }
+        }
+
+        tree.add_layer(first_builder.build());
+        tree.add_layer(second_builder.build());
+        last2_layer = std::move(last_layer);
+        last_layer = std::move(bsvec.build_sorted());
+        if (verbose) {
+            fmt::println("Searching Symplectic<{}> by depth: depth {} classes {} {}/{}", N, depth, last_layer.size(), symplectic_count,
+                         symplectic_count_total);
+        }
+
+        if (last_layer.size() == 0) { break; }
+    }
+
+    assert(symplectic_count == symplectic_count_total || tree.nlayers() == 2 * max_depth);
+    return {std::move(tree)};
+}
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(search_depth) {
+    auto classes = [](const clfd::search::DepthTree<3>& depth_tree) {
+        const auto& tree = depth_tree.tree;
+        return vw::ints(1ul, tree.nlayers() / 2 + 1) |
+               vw::transform([&tree](auto depth) { return std::size_t(rgs::distance(circ::tree::Tree::Iter(tree, depth * 2))); }) |
+               rgs::to<std::vector>();
+    };
+    // With three qubits no two generators are disjoint, so depth equals gate count.
+    auto tree3 = clfd::search::search_depth<3>();
+    CHECK_EQ(classes(tree3), std::vector<std::size_t>{6, 72, 136, 6, 0});
+    CHECK_EQ(tree3.depth(), 5);
+    CHECK_EQ(clfd::search::search_depth<3>(false, 2).tree.layers, std::vector(tree3.tree.layers.begin(), tree3.tree.layers.begin() + 4));
+
+    auto pair = std::vector<std::byte>{std::byte(1), std::byte(1), std::byte(2), std::byte(7)};
+    CHECK_EQ(clfd::search::DepthTree<3>::decode(pair), (std::vector<std::byte>{std::byte(1), std::byte(2), std::byte(7)}));
+}
+// NOLINTEND
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./count.hpp"
+#include "./mitm.hpp"
+#include "./synthesis.hpp"
+#include "reduce/quick.hpp"
+
+namespace clfd::search {
+
+// A uniformly random symplectic matrix. Row pairs are drawn in turn by rejection: the x row is any nonzero vector
+// orthogonal to the earlier rows, and the z row any such vector pairing to 1 with it. Each pair is uniform over its
+// choices, and the number of choices does not depend on the earlier pairs.
+template <std::size_t N>
+[[nodiscard]] inline BitSymplectic<N> random_symplectic(std::mt19937_64& rng) noexcept {
+    using Row = Bv<2 * N>;
+    std::array<Row, 2 * N> rows;
+    auto draw = [&rng, &rows](std::size_t count, auto&& accept) {
+        for (;;) {
+            auto row = Row(rng() & Row::MASK);
+            auto orthogonal = [&](auto j) { return !BitSymplectic<N>::omega(row, rows[j]) && !BitSymplectic<N>::omega(row, rows[j + N]); };
+            if (accept(row) && rgs::all_of(vw::ints(0ul, count), orthogonal)) { return row; }
+        }
+    };
+    for (auto i = 0ul; i < N; i++) {
+        rows[i] = draw(i, [](Row row) { return row != Row::zero(); });
+        rows[i + N] = draw(i, [&rows, i](Row row) { return BitSymplectic<N>::omega(rows[i], row); });
+    }
+    return BitSymplectic<N>::from_array(rows);
+}
+
+// Distances and canonical-class counts of one layer. Layers stored in the table are counted exactly and have empty
+// intervals; deeper layers are estimated from samples.
+struct LayerEstimate {
+    std::size_t distance;
+    double classes;
+    double classes_low;
+    double classes_high;
+    double elements;
+    double elements_low;
+    double elements_high;
+    bool exact;
+};
+
+struct DistanceEstimate {
+    std::size_t samples = 0;
+    // Samples farther than the meet-in-the-middle search reaches.
+    std::size_t censored = 0;
+    std::vector<LayerEstimate> layers;
+    // The censored samples as one bucket for every distance from `tail->distance` on; empty when none were censored.
+    std::optional<LayerEstimate> tail;
+
+    // Rounded point estimates, in the format of `count<N>`, ending with the tail bucket if there is one.
+    [[nodiscard]] inline std::vector<LayerCount> summary() const {
+        auto round = [](const LayerEstimate& layer) {
+            return LayerCount{layer.distance, std::size_t(std::llround(layer.classes)), std::size_t(std::llround(layer.elements))};
+        };
+        auto result = layers | vw::transform(round) | rgs::to<std::vector>();
+        if (tail) { result.push_back(round(*tail)); }
+        return result;
+    }
+
+    // Peak bytes of `search<N>` (one tree byte per class plus three frontier layers of matrices) and bytes of the
+    // saved index, from the point estimates or from the upper bounds. The tail counts as a single layer, which can only
+    // overstate the frontier.
+    template <std::size_t N>
+    [[nodiscard]] inline std::pair<double, double> footprint(bool high = false) const noexcept {
+        auto counts = layers | vw::transform([high](const LayerEstimate& layer) { return high ? layer.classes_high : layer.classes; }) |
+                      rgs::to<std::vector>();
+        if (tail) { counts.push_back(high ? tail->classes_high : tail->classes); }
+        auto tree = 0.0;
+        auto peak = 0.0;
+        for (auto i = 0ul; i < counts.size(); i++) {
+            tree += counts[i];
+            auto frontier = counts[i] + (i >= 1 ? counts[i - 1] : 0.0) + (i >= 2 ? counts[i - 2] : 0.0);
+            peak = std::max(peak, tree + frontier * double(sizeof(BitSymplectic<N>)));
+        }
+        return {peak, tree * double(sizeof(IndexEntry<N>))};
+    }
+};
+
+// Estimates the distance distribution from a table truncated at depth k. Layers up to k are read off the table; for
+// the rest, `samples` uniform matrices are solved by meet-in-the-middle up to distance 2k, and those beyond form the
+// tail bucket at distance 2k + 1. A class of size s is drawn with probability s / |Sp|, so `|Sp| / s` per sample
+// estimates class counts without bias. Element counts get Wilson intervals and class counts normal ones, both with `z`
+// standard errors. Sample `i` is seeded by `seed + i`, so the result does not depend on `nthreads`.
+template <std::size_t N>
+[[nodiscard]] inline DistanceEstimate estimate_distances(const SynthesisTable<N>& table, std::size_t samples, std::uint64_t seed = 0,
+                                                         double z = 1.96, std::size_t nthreads = std::thread::hardware_concurrency()) {
+    auto total = double(symplectic_matrix_count(N));
+    DistanceEstimate result{.samples = samples, .censored = 0, .layers = {}, .tail = std::nullopt};
+    for (const auto& entry : table.index()) {
+        auto distance = table.distance(entry);
+        while (result.layers.size() <= distance) {
+            result.layers.push_back({.distance = result.layers.size(),
+                                     .classes = 0,
+                                     .classes_low = 0,
+                                     .classes_high = 0,
+                                     .elements = 0,
+                                     .elements_low = 0,
+                                     .elements_high = 0,
+                                     .exact = true});
+        }
+        result.layers[distance].classes += 1;
+        result.layers[distance].elements += double(quick_reduce_eqcount(entry.canonical));
+    }
+    for (auto& layer : result.layers) {
+        layer.classes_low = layer.classes_high = layer.classes;
+        layer.elements_low = layer.elements_high = layer.elements;
+    }
+
+    auto mitm = MeetInMiddle<N>(table);
+    std::vector<std::pair<std::optional<std::size_t>, std::size_t>> solved(samples);
+    auto next = std::atomic<std::size_t>(0);
+    auto worker = [&] {
+        for (auto i = next++; i < samples; i = next++) {
+            auto rng = std::mt19937_64(seed + i);
+            auto target = random_symplectic<N>(rng);
+            auto synthesis = mitm.synthesize(target, 1);
+            solved[i] = {synthesis ? std::optional(synthesis->gens.size()) : std::nullopt, quick_reduce_eqcount(quick_reduce(target))};
+        }
+    };
+    std::vector<std::thread> threads;
+    for (auto t = 1ul; t < std::max(nthreads, 1ul); t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto n = double(samples);
+    auto exact_layers = result.layers.size();
+    auto sampled = [](std::size_t distance) {
+        return LayerEstimate{.distance = distance,
+                             .classes = 0,
+                             .classes_low = 0,
+                             .classes_high = 0,
+                             .elements = 0,
+                             .elements_low = 0,
+                             .elements_high = 0,
+                             .exact = false};
+    };
+    for (auto [distance, eqcount] : solved) {
+        if (!distance) {
+            result.censored++;
+            continue;
+        }
+        while (result.layers.size() <= *distance) {
+            result.layers.push_back(sampled(result.layers.size()));
+        }
+    }
+    auto fill = [&](LayerEstimate& layer, std::optional<std::size_t> bucket) {
+        auto hits = 0.0;
+        auto sum = 0.0;
+        auto sum2 = 0.0;
+        for (auto [distance, eqcount] : solved) {
+            if (distance != bucket) { continue; }
+            hits += 1;
+            sum += total / double(eqcount);
+            sum2 += (total / double(eqcount)) * (total / double(eqcount));
+        }
+        auto p = hits / n;
+        auto center = (p + z * z / (2 * n)) / (1 + z * z / n);
+        auto half = z / (1 + z * z / n) * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n));
+        layer.elements = p * total;
+        layer.elements_low = std::max(center - half, 0.0) * total;
+        layer.elements_high = std::min(center + half, 1.0) * total;
+
+        auto mean = sum / n;
+        auto error = samples > 1 ? std::sqrt(std::max(sum2 / n - mean * mean, 0.0) / (n - 1)) : 0.0;
+        layer.classes = mean;
+        layer.classes_low = std::max(mean - z * error, hits > 0 ? 1.0 : 0.0);
+        layer.classes_high = hits > 0 ? std::min(mean + z * error, layer.elements_high) : layer.elements_high;
+    };
+    for (auto d = exact_layers; d < result.layers.size(); d++) {
+        fill(result.layers[d], d);
+    }
+    if (result.censored > 0) {
+        result.tail = sampled(2 * table.max_distance() + 1);
+        fill(*result.tail, std::nullopt);
+    }
+    return result;
+}
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(estimate_distances) {
+    auto rng = std::mt19937_64(7);
+    std::unordered_map<clfd::BitSymplectic<2>, std::size_t> seen;
+    for (auto i = 0ul; i < 72000ul; i++) {
+        auto matrix = clfd::search::random_symplectic<2>(rng);
+        CHECK(matrix.check_symplecticity());
+        seen[matrix]++;
+    }
+    CHECK_EQ(seen.size(), clfd::symplectic_matrix_count(2));
+    CHECK(rgs::all_of(seen, [](auto&& kv) { return kv.second > 50 && kv.second < 150; }));
+
+    auto exact = clfd::search::count<3>();
+    auto partial = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>(false, {.max_layers = 2}));
+    auto estimate = clfd::search::estimate_distances(partial, 4000, 1, 4.0, 4);
+    CHECK_EQ(estimate.censored, 0);
+    CHECK_EQ(estimate.layers.size(), exact.size());
+    for (auto i = 0ul; i < exact.size(); i++) {
+        const auto& layer = estimate.layers[i];
+        CHECK_EQ(layer.exact, i <= 2);
+        CHECK(layer.classes_low <= double(exact[i].classes));
+        CHECK(double(exact[i].classes) <= layer.classes_high);
+        CHECK(layer.elements_low <= double(exact[i].elements));
+        CHECK(double(exact[i].elements) <= layer.elements_high);
+    }
+    CHECK_EQ(estimate.summary()[2].classes, exact[2].classes);
+    auto serial = clfd::search::estimate_distances(partial, 500, 1, 4.0, 1).summary();
+    auto parallel = clfd::search::estimate_distances(partial, 500, 1, 4.0, 3).summary();
+    CHECK(rgs::equal(serial, parallel, [](auto a, auto b) { return a.classes == b.classes && a.elements == b.elements; }));
+    auto [search_bytes, index_bytes] = estimate.footprint<3>();
+    CHECK(search_bytes > 0 && index_bytes > search_bytes / 10);
+    CHECK(!estimate.tail.has_value());
+
+    // Depth 1 reaches distance 2; the rest is one tail bucket, counted by the summary and the upper bounds.
+    auto shallow = clfd::search::estimate_distances(clfd::search::SynthesisTable<3>::build(clfd::search::search<3>(false, {.max_layers = 1})),
+                                                    4000, 1, 4.0, 4);
+    CHECK(shallow.censored > 0);
+    CHECK(shallow.tail.has_value());
+    CHECK_EQ(shallow.tail->distance, 3);
+    auto beyond_classes = 0.0;
+    auto beyond_elements = 0.0;
+    for (auto i = 3ul; i < exact.size(); i++) {
+        beyond_classes += double(exact[i].classes);
+        beyond_elements += double(exact[i].elements);
+    }
+    CHECK(shallow.tail->classes_low <= beyond_classes && beyond_classes <= shallow.tail->classes_high);
+    CHECK(shallow.tail->elements_low <= beyond_elements && beyond_elements <= shallow.tail->elements_high);
+    CHECK_EQ(shallow.summary().back().distance, 3);
+    CHECK_EQ(shallow.summary().size(), shallow.layers.size() + 1);
+    auto all_classes = 0.0;
+    for (auto layer : exact) {
+        all_classes += double(layer.classes);
+    }
+    CHECK(shallow.footprint<3>(true).second >= all_classes * double(sizeof(clfd::search::IndexEntry<3>)));
+}
+// NOLINTEND
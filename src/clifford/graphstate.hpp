@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "../circuit/gateset/symmetry3.hpp"
+#include "../utils/bitvec.hpp"
+#include "../utils/fmt.hpp"
+#include "./state.hpp"
+
+namespace clfd {
+
+// An undirected graph on N qubits as adjacency rows, and the graph state stabilized by X_v Z^{N(v)}.
+template <std::size_t N>
+class GraphState {
+    static_assert(N <= 7ul);
+    std::array<Bv<N>, N> rows;
+
+   public:
+    inline constexpr GraphState() noexcept { rows.fill(Bv<N>::zero()); }
+    // Inverse of `key()`.
+    [[nodiscard]] inline constexpr static GraphState from_key(std::uint64_t key) noexcept {
+        GraphState result;
+        for (auto a = 0ul; a < N; a++) {
+            for (auto b = a + 1; b < N; b++) {
+                if (key & 1) { result.toggle(a, b); }
+                key >>= 1;
+            }
+        }
+        return result;
+    }
+
+    [[nodiscard]] inline constexpr auto operator<=>(const GraphState&) const noexcept = default;
+
+    [[nodiscard]] inline constexpr Bv<N> neighbors(std::size_t v) const noexcept { return rows[v]; }
+    [[nodiscard]] inline constexpr bool edge(std::size_t a, std::size_t b) const noexcept { return rows[a][b]; }
+    inline constexpr void toggle(std::size_t a, std::size_t b) noexcept {
+        assert(a != b);
+        rows[a] = rows[a].xor_at(b, true);
+        rows[b] = rows[b].xor_at(a, true);
+    }
+
+    // Complements the neighborhood of `v`, one row XOR per neighbor. The result is LC-equivalent: it is the state
+    // after √(-iX) on `v` and √(iZ) on its neighbors.
+    inline constexpr void do_local_complement(std::size_t v) noexcept {
+        auto nv = rows[v];
+        for (auto u = 0ul; u < N; u++) {
+            if (nv[u]) { rows[u] ^= nv.xor_at(u, true); }
+        }
+    }
+
+    // Qubit `q` becomes qubit `perm[q]`.
+    [[nodiscard]] inline constexpr GraphState permuted(const std::array<QIdx, N>& perm) const noexcept {
+        GraphState result;
+        for (auto a = 0ul; a < N; a++) {
+            auto row = Bv<N>::zero();
+            for (auto b = 0ul; b < N; b++) {
+                row = row.update(perm[b], rows[a][b]);
+            }
+            result.rows[perm[a]] = row;
+        }
+        return result;
+    }
+
+    // Qubits `a` and `b` trade places.
+    [[nodiscard]] inline constexpr GraphState swapped(std::size_t a, std::size_t b) const noexcept {
+        auto result = *this;
+        std::swap(result.rows[a], result.rows[b]);
+        for (auto& row : result.rows) {
+            auto bit = row[a];
+            row = row.update(a, row[b]).update(b, bit);
+        }
+        return result;
+    }
+
+    // Upper triangle, row by row, in N(N-1)/2 bits.
+    [[nodiscard]] inline constexpr std::uint64_t key() const noexcept {
+        auto result = 0ul;
+        auto shift = 0ul;
+        for (auto a = 0ul; a < N; a++) {
+            result |= (rows[a].uint() >> (a + 1)) << shift;
+            shift += N - a - 1;
+        }
+        return result;
+    }
+
+    [[nodiscard]] inline constexpr StabilizerState<N> state() const noexcept {
+        std::array<Bv<2 * N>, N> vectors;
+        for (auto v = 0ul; v < N; v++) {
+            vectors[v] = Bv<2 * N>(rows[v].uint() << N).update(v, true);
+        }
+        return StabilizerState<N>(vectors);
+    }
+
+    [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("Graph[{}]", fmt::join(rows, " ")); }
+};
+
+template <std::size_t N>
+auto format_as(const GraphState<N>& graph) {
+    return graph.fmt();
+}
+
+// `state == local · graph.state()`, with `local[q]` applied to qubit `q` as in `StabilizerState::do_local`.
+template <std::size_t N>
+struct GraphForm {
+    GraphState<N> graph;
+    std::array<circ::Symmetry3, N> local;
+
+    [[nodiscard]] inline constexpr circ::Symmetry3N<N> local_layer() const noexcept {
+        auto result = circ::Symmetry3N<N>();
+        for (auto q = 0ul; q < N; q++) {
+            result = result.update(q, local[q]);
+        }
+        return result;
+    }
+};
+
+// Hadamards on the qubits outside the pivots of the X block make it invertible, since the Z parts of the remaining
+// stabilizers are determined by their non-pivot columns. Reducing the X block to the identity leaves a symmetric Z
+// block, and phases clear its diagonal.
+template <std::size_t N>
+[[nodiscard]] inline constexpr GraphForm<N> graph_form(const StabilizerState<N>& state) noexcept {
+    auto vectors = state.vectors();
+    auto eliminate = [&vectors](std::size_t bit, std::size_t rank) {
+        auto pivot = std::find_if(vectors.begin() + std::ptrdiff_t(rank), vectors.end(), [bit](auto v) { return v[bit]; });
+        if (pivot == vectors.end()) { return false; }
+        std::swap(*pivot, vectors[rank]);
+        for (auto i = 0ul; i < N; i++) {
+            if (i != rank && vectors[i][bit]) { vectors[i] ^= vectors[rank]; }
+        }
+        return true;
+    };
+
+    std::array<bool, N> hadamard{};
+    auto rank = 0ul;
+    for (auto q = 0ul; q < N; q++) {
+        if (eliminate(q, rank)) {
+            rank++;
+        } else {
+            hadamard[q] = true;
+        }
+    }
+    for (auto& v : vectors) {
+        for (auto q = 0ul; q < N; q++) {
+            if (!hadamard[q]) { continue; }
+            auto x = v[q];
+            v = v.update(q, v[q + N]).update(q + N, x);
+        }
+    }
+    for (auto q = 0ul; q < N; q++) {
+        [[maybe_unused]] auto found = eliminate(q, q);
+        assert(found);
+    }
+
+    GraphForm<N> result;
+    for (auto q = 0ul; q < N; q++) {
+        auto phase = vectors[q][q + N];
+        for (auto u = q + 1; u < N; u++) {
+            assert(vectors[q][u + N] == vectors[u][q + N]);
+            if (vectors[q][u + N]) { result.graph.toggle(q, u); }
+        }
+        // The inverse of H then S is S then H, up to Paulis.
+        result.local[q] = circ::Symmetry3(std::uint8_t((phase ? 0b010 : 0) | (hadamard[q] ? 0b100 : 0)));
+    }
+    return result;
+}
+
+// Least key of the class of every graph, indexed by `key()`, built on first use: 2^21 entries (8 MiB) at N = 7.
+// Local complementations and adjacent transpositions link the graphs of a class, so scanning keys in order and
+// labelling each unvisited component from the key that found it labels it with its least key.
+template <std::size_t N>
+[[nodiscard]] inline const std::vector<std::uint32_t>& lc_class_table() {
+    static const auto table = [] {
+        constexpr auto unset = std::uint32_t(-1);
+        std::vector<std::uint32_t> result(1ul << (N * (N - 1) / 2), unset);
+        std::vector<std::uint32_t> stack;
+        for (auto start = 0u; start < result.size(); start++) {
+            if (result[start] != unset) { continue; }
+            result[start] = start;
+            stack.push_back(start);
+            while (!stack.empty()) {
+                auto graph = GraphState<N>::from_key(stack.back());
+                stack.pop_back();
+                auto visit = [&](const GraphState<N>& next) {
+                    auto key = next.key();
+                    if (result[key] != unset) { return; }
+                    result[key] = start;
+                    stack.push_back(std::uint32_t(key));
+                };
+                for (auto v = 0ul; v < N; v++) {
+                    auto next = graph;
+                    next.do_local_complement(v);
+                    visit(next);
+                    if (v + 1 < N) { visit(graph.swapped(v, v + 1)); }
+                }
+            }
+        }
+        return result;
+    }();
+    return table;
+}
+
+// A key shared exactly by the stabilizer states equivalent under local Cliffords and qubit relabeling: the least
+// `key()` among the graphs reachable by local complementation and relabeling, since two graph states are LC-equivalent
+// iff a sequence of local complementations relates them.
+template <std::size_t N>
+[[nodiscard]] inline std::uint64_t lc_class_key(const GraphState<N>& graph) {
+    return lc_class_table<N>()[graph.key()];
+}
+template <std::size_t N>
+[[nodiscard]] inline std::uint64_t lc_class_key(const StabilizerState<N>& state) {
+    return lc_class_key(graph_form(state).graph);
+}
+
+}  // namespace clfd
+
+// NOLINTBEGIN
+TEST_FN(graph_state) {
+    auto all_local = circ::Symmetry3::all();
+    for (auto i = 0ul; i < 300ul; i++) {
+        auto matrix = clfd::BitSymplectic<4>::identity();
+        perform_random_gates(matrix, 30, clfd::CliffordGate<4>::all_gates(), Bv<2>(0b11));
+        auto state = clfd::StabilizerState<4>::from(matrix);
+        auto form = clfd::graph_form(state);
+        auto rebuilt = form.graph.state();
+        for (auto q = 0ul; q < 4; q++) {
+            rebuilt.do_local(q, form.local[q]);
+        }
+        CHECK_EQ(rebuilt, state);
+
+        auto graph_matrix = clfd::BitSymplectic<4>::identity();
+        for (auto q = 0ul; q < 4; q++) {
+            graph_matrix.do_hadamard_l(q);
+        }
+        for (auto a = 0ul; a < 4; a++) {
+            for (auto b = a + 1; b < 4; b++) {
+                if (!form.graph.edge(a, b)) { continue; }
+                graph_matrix.do_hadamard_l(b);
+                graph_matrix.do_cnot_l(a, b);
+                graph_matrix.do_hadamard_l(b);
+            }
+        }
+        graph_matrix.do_mul_l(form.local_layer());
+        CHECK_EQ(clfd::StabilizerState<4>::from(graph_matrix), state);
+
+        auto moved = state.permuted({2, 0, 3, 1});
+        for (auto q = 0ul; q < 4; q++) {
+            moved.do_local(q, all_local[std::experimental::randint(0ul, all_local.size() - 1)]);
+        }
+        CHECK_EQ(clfd::lc_class_key(moved), clfd::lc_class_key(state));
+    }
+
+    // Graphs up to LC and relabeling: 3, 6, 11, 26 and 59 classes on 3 to 7 vertices.
+    auto classes = []<std::size_t N>(std::integral_constant<std::size_t, N>) {
+        std::unordered_set<std::uint64_t> keys;
+        for (auto key = 0ul; key < (1ul << (N * (N - 1) / 2)); key++) {
+            auto graph = clfd::GraphState<N>::from_key(key);
+            CHECK_EQ(graph.key(), key);
+            keys.insert(clfd::lc_class_key(graph));
+        }
+        return keys.size();
+    };
+    CHECK_EQ(classes(std::integral_constant<std::size_t, 3>{}), 3);
+    CHECK_EQ(classes(std::integral_constant<std::size_t, 4>{}), 6);
+    CHECK_EQ(classes(std::integral_constant<std::size_t, 5>{}), 11);
+    CHECK_EQ(classes(std::integral_constant<std::size_t, 6>{}), 26);
+    CHECK_EQ(classes(std::integral_constant<std::size_t, 7>{}), 59);
+
+    // Keys are a lookup once the table is built, so 10^5 of them at N = 7 take well under a second.
+    auto graph = clfd::GraphState<7>::from_key(0x12345);
+    auto begin = std::chrono::steady_clock::now();
+    auto sum = 0ul;
+    for (auto i = 0ul; i < 100000ul; i++) {
+        graph.do_local_complement(i % 7);
+        sum += clfd::lc_class_key(graph.swapped(i % 7, (i + 3) % 7));
+    }
+    CHECK(sum > 0);
+    CHECK(std::chrono::steady_clock::now() - begin < std::chrono::seconds(1));
+}
+// NOLINTEND
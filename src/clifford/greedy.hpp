@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/gateset/gate/gate.hpp"
+#include "../circuit/gateset/symmetry3.hpp"
+#include "../defines.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./synthesis.hpp"
+#include "./tableau.hpp"
+
+namespace clfd::search {
+
+inline void emit_local(std::vector<circ::gate::Gate>& gates, circ::Symmetry3 op, QIdx q) {
+    if (op.bv()[0]) { gates.emplace_back(circ::gate::Gate1::H{}(q)); }
+    if (op.bv()[1]) { gates.emplace_back(circ::gate::Gate1::S{}(q)); }
+    if (op.bv()[2]) { gates.emplace_back(circ::gate::Gate1::H{}(q)); }
+}
+inline void emit_local(std::vector<circ::gate::Gate>& gates, circ::CliffordGenOp op, QIdx q) {
+    if (op == circ::CliffordGenOp::HP) { emit_local(gates, circ::Symmetry3::hp(), q); }
+    if (op == circ::CliffordGenOp::PH) {
+        gates.emplace_back(circ::gate::Gate1::S{}(q));
+        gates.emplace_back(circ::gate::Gate1::H{}(q));
+    }
+}
+
+// A `Synthesis` as gates on its own N qubits: `synthesis.matrix() == perm * product(gates)`.
+template <std::size_t N>
+struct LocalCircuit {
+    std::vector<circ::gate::Gate> gates;
+    std::array<QIdx, N> perm;
+};
+
+// Qubit map of a permutation matrix: `matrix * X_a == X_result[a]`.
+template <std::size_t N>
+[[nodiscard]] inline std::array<QIdx, N> qubit_map(const BitSymplectic<N>& matrix) noexcept {
+    std::array<QIdx, N> result{};
+    for (auto a = 0ul; a < N; a++) {
+        for (auto b = 0ul; b < N; b++) {
+            if (matrix.get(b, a)) { result[a] = QIdx(b); }
+        }
+    }
+    return result;
+}
+
+// With R = L S A ρ and ρ⁻¹ G_q ρ = G_ρ⁻¹(q): R = (L ρ) S' A', where S' and A' act on relabeled qubits and L ρ is the
+// final relabeling.
+template <std::size_t N>
+[[nodiscard]] inline LocalCircuit<N> synthesis_circuit(const Synthesis<N>& synthesis) {
+    auto rho = qubit_map(BitSymplectic<N>::identity() * synthesis.right_perm);
+    std::array<QIdx, N> rho_inv{};
+    for (auto a = 0ul; a < N; a++) {
+        rho_inv[rho[a]] = QIdx(a);
+    }
+    auto perm = (synthesis.left_perm * BitSymplectic<N>::identity()) * (BitSymplectic<N>::identity() * synthesis.right_perm);
+    LocalCircuit<N> result{.gates = {}, .perm = qubit_map(perm)};
+    for (auto gen : synthesis.gens) {
+        auto ctrl = rho_inv[gen.ictrl()];
+        auto target = rho_inv[gen.inot()];
+        emit_local(result.gates, gen.op_ctrl(), ctrl);
+        emit_local(result.gates, gen.op_not(), target);
+        result.gates.emplace_back(circ::gate::Gate2(circ::gate::Gate2::CX{}, ctrl, target));
+    }
+    for (auto q = 0ul; q < N; q++) {
+        emit_local(result.gates, synthesis.left_sym[q], rho_inv[q]);
+    }
+    return result;
+}
+
+// A circuit for an n-qubit Clifford: `target == perm * product(gates)`, gates applied first to last and `perm` mapping
+// qubit q to `perm[q]` at the end for free.
+struct LargeSynthesis {
+    std::size_t nqubits;
+    std::vector<circ::gate::Gate> gates;
+    std::vector<QIdx> perm;
+
+    [[nodiscard]] inline std::size_t cx_count() const noexcept {
+        return std::size_t(rgs::count_if(gates, [](auto&& gate) { return std::holds_alternative<circ::gate::Gate2>(gate); }));
+    }
+    [[nodiscard]] inline Tableau matrix() const noexcept {
+        auto result = Tableau::identity(nqubits);
+        for (const auto& gate : gates) {
+            result.do_mul_l(gate);
+        }
+        result.do_permute_l(perm);
+        return result;
+    }
+};
+
+enum class EliminationOrder : uint8_t { Naive, Greedy };
+
+// Column-pair elimination. Each step maps columns j and j + n of the working matrix to X_k and Z_k with left operations,
+// after which qubit k is finished. `Naive` takes columns in order; `Greedy` takes the column pair whose elimination is
+// cheapest in CX gates. Every candidate is scored at once from word operations on the unfinished rows, into buffers
+// reused across steps, so a step costs O(n² / 64) words plus one counter update per nonzero entry. Once N qubits remain,
+// the residual is synthesized optimally from `table` when it is given.
+template <std::size_t N>
+class GreedySynthesizer {
+    enum class Op : uint8_t { H, S, HPH, CX };
+    struct Step {
+        Op op;
+        std::size_t a, b;
+    };
+    // x in bit 0, z in bit 1, for each working qubit.
+    struct Columns {
+        std::vector<uint8_t> u, v;
+
+        inline void apply(Step step) noexcept {
+            for (auto* col : {&u, &v}) {
+                auto& p = (*col)[step.a];
+                switch (step.op) {
+                    case Op::H: p = uint8_t((p >> 1) | ((p & 1) << 1)); break;
+                    case Op::S: p ^= uint8_t((p & 1) << 1); break;
+                    case Op::HPH: p ^= uint8_t(p >> 1); break;
+                    case Op::CX:
+                        (*col)[step.b] ^= p & 1;
+                        p ^= (*col)[step.b] & 2;
+                        break;
+                }
+            }
+        }
+    };
+
+    // Candidate scores over column pairs, as bit words over columns and per-column counts.
+    struct Scores {
+        std::vector<std::uint64_t> candidates, found_both, found_u;
+        std::vector<std::uint32_t> u_nonzero, v_nonzero, v_left, pivot_both, pivot_u;
+
+        inline void reset(std::size_t n) {
+            for (auto* words : {&candidates, &found_both, &found_u}) {
+                words->assign((n + 63) / 64, 0);
+            }
+            for (auto* counts : {&u_nonzero, &v_nonzero, &v_left, &pivot_both, &pivot_u}) {
+                counts->assign(n, 0);
+            }
+        }
+    };
+
+    const SynthesisTable<N>* table;
+    EliminationOrder order;
+
+   public:
+    inline explicit GreedySynthesizer(const SynthesisTable<N>* table = nullptr, EliminationOrder order = EliminationOrder::Greedy)
+        : table(table), order(order) {}
+
+    [[nodiscard]] inline LargeSynthesis synthesize(const Tableau& target) const {
+        auto n = target.nqubits();
+        auto work = target;
+        std::vector<Step> steps;
+        std::vector<std::size_t> rows(n), cols(n);  // unfinished qubits and column pairs
+        std::iota(rows.begin(), rows.end(), 0ul);
+        std::iota(cols.begin(), cols.end(), 0ul);
+        std::vector<QIdx> sigma(n);  // column pair j ends on qubit sigma[j]
+
+        std::optional<Synthesis<N>> residual;
+        Scores scores;
+        while (!cols.empty()) {
+            if (rows.size() == N && table != nullptr && (residual = table->synthesize(work.restrict<N>(rows, cols)))) { break; }
+            auto [j, pivot] = choose(work, rows, cols, scores);
+            auto columns = extract(work, rows, cols[j]);
+            eliminate(columns, rows, pivot, [&](Step step) {
+                columns.apply(step);
+                apply(work, step);
+                steps.push_back(step);
+            });
+            sigma[cols[j]] = QIdx(rows[pivot]);
+            rows.erase(rows.begin() + std::ptrdiff_t(pivot));
+            cols.erase(cols.begin() + std::ptrdiff_t(j));
+        }
+
+        // target = steps⁻¹ · P_sigma · residual, with the residual on qubits `cols`; moving P_sigma to the end relabels
+        // the steps by its inverse.
+        LargeSynthesis result{.nqubits = n, .gates = {}, .perm = sigma};
+        if (residual) { emit_residual(result, *residual, rows, cols); }
+        std::vector<QIdx> inverse(n);
+        for (auto q = 0ul; q < n; q++) {
+            inverse[result.perm[q]] = QIdx(q);
+        }
+        for (auto step = steps.rbegin(); step != steps.rend(); ++step) {
+            emit(result.gates, {step->op, inverse[step->a], inverse[step->b]});
+        }
+        assert(result.matrix() == target);
+        return result;
+    }
+
+   private:
+    [[nodiscard]] inline static Columns extract(const Tableau& work, const std::vector<std::size_t>& rows, std::size_t col) noexcept {
+        auto n = work.nqubits();
+        Columns result{std::vector<uint8_t>(n), std::vector<uint8_t>(n)};
+        for (auto q : rows) {
+            result.u[q] = uint8_t(work.get(q, col) | work.get(q + n, col) << 1);
+            result.v[q] = uint8_t(work.get(q, col + n) | work.get(q + n, col + n) << 1);
+        }
+        return result;
+    }
+
+    // Pivot on a qubit where both columns are nonzero, so that clearing u does not spread v.
+    [[nodiscard]] inline static std::size_t pivot_of(const Columns& columns, const std::vector<std::size_t>& rows) noexcept {
+        auto first = rows.size();
+        for (auto i = 0ul; i < rows.size(); i++) {
+            if (columns.u[rows[i]] == 0) { continue; }
+            if (columns.v[rows[i]] != 0) { return i; }
+            first = std::min(first, i);
+        }
+        assert(first < rows.size());
+        return first;
+    }
+
+    // Bits `first + 64 w` onwards of `row`.
+    [[nodiscard]] inline static std::uint64_t word_at(std::span<const std::uint64_t> row, std::size_t first, std::size_t w) noexcept {
+        auto bit = first + 64 * w;
+        auto shift = bit % 64;
+        auto word = row[bit / 64] >> shift;
+        if (shift != 0 && bit / 64 + 1 < row.size()) { word |= row[bit / 64 + 1] << (64 - shift); }
+        return word;
+    }
+
+    // Index into `cols` and into `rows` of the next elimination. With pivot k, `eliminate` spends a CX on every other
+    // row where u is nonzero, and then on every other row where v is nonzero after the u step. That step leaves v alone
+    // where u is zero; elsewhere it turns u into X and adds the x bit c of the transformed v[k], so v ends up zero exactly
+    // where it was zero (c = 0) or equal to u (c = 1).
+    [[nodiscard]] inline std::pair<std::size_t, std::size_t> choose(const Tableau& work, const std::vector<std::size_t>& rows,
+                                                                    const std::vector<std::size_t>& cols, Scores& scores) const noexcept {
+        if (order == EliminationOrder::Naive) {
+            auto columns = extract(work, rows, cols[0]);
+            auto diagonal = rgs::find(rows, cols[0]);
+            if (diagonal != rows.end() && columns.u[*diagonal] != 0) { return {0, std::size_t(diagonal - rows.begin())}; }
+            return {0, pivot_of(columns, rows)};
+        }
+        auto n = work.nqubits();
+        scores.reset(n);
+        for (auto col : cols) {
+            scores.candidates[col / 64] |= std::uint64_t(1) << (col % 64);
+        }
+        auto count = [](std::vector<std::uint32_t>& counts, std::size_t w, std::uint64_t bits) {
+            for (; bits != 0; bits &= bits - 1) {
+                counts[64 * w + std::size_t(std::countr_zero(bits))] += 1;
+            }
+        };
+        auto mark = [](std::vector<std::uint32_t>& pivots, std::size_t w, std::uint64_t bits, std::size_t i) {
+            for (; bits != 0; bits &= bits - 1) {
+                pivots[64 * w + std::size_t(std::countr_zero(bits))] = std::uint32_t(i);
+            }
+        };
+        for (auto i = 0ul; i < rows.size(); i++) {
+            auto x = work.row(rows[i]);
+            auto z = work.row(rows[i] + n);
+            for (auto w = 0ul; w < scores.candidates.size(); w++) {
+                auto ux = x[w], uz = z[w], vx = word_at(x, n, w), vz = word_at(z, n, w);
+                auto u = (ux | uz) & scores.candidates[w];
+                auto v = (vx | vz) & scores.candidates[w];
+                auto v_left = (~u & v) | (u & ((ux ^ vx) | (uz ^ vz)));
+                count(scores.u_nonzero, w, u);
+                count(scores.v_nonzero, w, v);
+                count(scores.v_left, w, v_left & scores.candidates[w]);
+                mark(scores.pivot_both, w, u & v & ~scores.found_both[w], i);
+                mark(scores.pivot_u, w, u & ~scores.found_u[w], i);
+                scores.found_both[w] |= u & v;
+                scores.found_u[w] |= u;
+            }
+        }
+
+        auto best = std::pair{0ul, 0ul};
+        auto best_cost = std::numeric_limits<std::size_t>::max();
+        for (auto j = 0ul; j < cols.size(); j++) {
+            auto col = cols[j];
+            auto both = (scores.found_both[col / 64] >> (col % 64)) & 1;
+            auto pivot = std::size_t(both ? scores.pivot_both[col] : scores.pivot_u[col]);
+            auto k = rows[pivot];
+            auto u = work.get(k, col) | work.get(k + n, col) << 1;
+            auto v = work.get(k, col + n) | work.get(k + n, col + n) << 1;
+            auto c = u == 0b10 ? v >> 1 : v & 1;
+            auto cost = scores.u_nonzero[col] - 1 + (c ? scores.v_left[col] - (v != u) : scores.v_nonzero[col] - (v != 0));
+            if (cost < best_cost) {
+                best = {j, pivot};
+                best_cost = cost;
+            }
+        }
+        return best;
+    }
+
+    // Maps u to X_k, then v to Z_k; v commutes with nothing but X_k's partner, so its k entry is never cleared.
+    template <typename F>
+    inline static void eliminate(Columns& columns, const std::vector<std::size_t>& rows, std::size_t pivot, F&& emit) noexcept {
+        auto k = rows[pivot];
+        for (auto q : rows) {
+            if (columns.u[q] == 0b10) { emit(Step{Op::H, q, q}); }
+            if (columns.u[q] == 0b11) { emit(Step{Op::S, q, q}); }
+        }
+        for (auto q : rows) {
+            if (q != k && columns.u[q] != 0) { emit(Step{Op::CX, k, q}); }
+        }
+        assert(columns.u[k] == 0b01 && (columns.v[k] & 0b10));
+        for (auto q : rows) {
+            if (q == k || columns.v[q] == 0) { continue; }
+            if (columns.v[q] == 0b01) { emit(Step{Op::H, q, q}); }
+            if (columns.v[q] == 0b11) { emit(Step{Op::HPH, q, q}); }
+            emit(Step{Op::CX, q, k});
+        }
+        if (columns.v[k] == 0b11) { emit(Step{Op::HPH, k, k}); }
+    }
+
+    inline static void apply(Tableau& work, Step step) noexcept {
+        switch (step.op) {
+            case Op::H: work.do_hadamard_l(step.a); break;
+            case Op::S: work.do_phase_l(step.a); break;
+            case Op::HPH: work.do_hphaseh_l(step.a); break;
+            case Op::CX: work.do_cnot_l(step.a, step.b); break;
+        }
+    }
+
+    inline static void emit(std::vector<circ::gate::Gate>& gates, Step step) {
+        using namespace circ::gate;
+        auto a = QIdx(step.a);
+        switch (step.op) {
+            case Op::H: gates.emplace_back(Gate1::H{}(a)); break;
+            case Op::S: gates.emplace_back(Gate1::S{}(a)); break;
+            case Op::HPH:
+                gates.emplace_back(Gate1::H{}(a));
+                gates.emplace_back(Gate1::S{}(a));
+                gates.emplace_back(Gate1::H{}(a));
+                break;
+            case Op::CX: gates.emplace_back(Gate2(Gate2::CX{}, a, QIdx(step.b))); break;
+        }
+    }
+    inline static void emit_residual(LargeSynthesis& result, const Synthesis<N>& residual, const std::vector<std::size_t>& rows,
+                                     const std::vector<std::size_t>& cols) {
+        auto local = synthesis_circuit(residual);
+        for (const auto& gate : local.gates) {
+            result.gates.push_back(circ::gate::relabeled(gate, [&](auto q) { return cols[q]; }));
+        }
+        for (auto a = 0ul; a < N; a++) {
+            result.perm[cols[a]] = QIdx(rows[local.perm[a]]);
+        }
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(greedy_synthesis) {
+    auto table = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>());
+    auto greedy = clfd::search::GreedySynthesizer<3>(&table);
+    auto naive = clfd::search::GreedySynthesizer<3>(nullptr, clfd::search::EliminationOrder::Naive);
+
+    for (auto n : {1ul, 2ul, 3ul, 70ul}) {
+        auto target = clfd::random_tableau(n, 20 * n);
+        CHECK_EQ(greedy.synthesize(target).matrix(), target);
+        CHECK_EQ(naive.synthesize(target).matrix(), target);
+    }
+
+    auto greedy_cx = 0ul;
+    auto naive_cx = 0ul;
+    for (auto i = 0ul; i < 20ul; i++) {
+        auto target = clfd::random_tableau(12, 400);
+        auto fast = greedy.synthesize(target);
+        auto slow = naive.synthesize(target);
+        CHECK_EQ(fast.matrix(), target);
+        CHECK_EQ(slow.matrix(), target);
+        greedy_cx += fast.cx_count();
+        naive_cx += slow.cx_count();
+    }
+    CHECK(greedy_cx < naive_cx);
+}
+// NOLINTEND
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/gateset/gate/gate.hpp"
+#include "../circuit/gateset/permutation.hpp"
+#include "../circuit/gateset/symmetry3.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./gate.hpp"
+#include "./greedy.hpp"
+#include "./synthesis.hpp"
+#include "./tableau.hpp"
+#include "reduce/quick.hpp"
+#include "reduce/restricted.hpp"
+
+namespace clfd::search {
+
+// Qubit-level support of `matrix`: bit `i * 2N + j` is set iff the 2x2 block of row qubit i and column qubit j is nonzero.
+template <std::size_t N>
+[[nodiscard]] inline constexpr Bv<2 * N * N> block_support(const BitSymplectic<N>& matrix) noexcept {
+    return matrix.kappa() & BitSymplectic<N>::MASK_XCOLS;
+}
+
+// Splits a matrix of local Cliffords and a qubit permutation as `left_perm * (left_sym * identity)`.
+template <std::size_t N>
+[[nodiscard]] inline std::optional<std::pair<circ::CircPerm, circ::Symmetry3N<N>>> monomial_decompose(const BitSymplectic<N>& matrix) noexcept {
+    for (auto perm : qubit_perms<N>([](auto&&) { return true; })) {
+        auto locals = (perm * BitSymplectic<N>::identity()).inverse() * matrix;
+        auto sym = circ::Symmetry3N<N>();
+        for (auto i = 0ul; i < N; i++) {
+            for (auto op : circ::Symmetry3::all()) {
+                auto block = circ::Symmetry3N<N>().update(i, op) * BitSymplectic<N>::identity();
+                if (rgs::all_of(std::array{std::pair{i, i}, std::pair{i, i + N}, std::pair{i + N, i}, std::pair{i + N, i + N}},
+                                [&](auto rc) { return block.get(rc.first, rc.second) == locals.get(rc.first, rc.second); })) {
+                    sym = sym.update(i, op);
+                }
+            }
+        }
+        if (perm * (sym * BitSymplectic<N>::identity()) == matrix) { return std::pair{perm, sym}; }
+    }
+    return std::nullopt;
+}
+
+struct IdaBudget {
+    std::chrono::steady_clock::duration time_limit = std::chrono::steady_clock::duration::max();
+    std::size_t max_nodes = std::numeric_limits<std::size_t>::max();
+};
+
+// A generator on two qubits of a `Tableau`, as the gates `synthesis_circuit` emits for a `CliffordGen`. Each gate is an
+// involution without phases, so a generator is undone by its gates in reverse.
+struct TableauGen {
+    std::array<std::size_t, 2> qubits;
+    std::vector<circ::gate::Gate> gates;
+
+    [[nodiscard]] inline bool disjoint(const TableauGen& other) const noexcept {
+        return rgs::none_of(qubits, [&](auto q) { return rgs::find(other.qubits, q) != other.qubits.end(); });
+    }
+    [[nodiscard]] inline Tableau operator*(Tableau matrix) const noexcept {
+        for (const auto& gate : gates) {
+            matrix.do_mul_l(gate);
+        }
+        return matrix;
+    }
+
+    // All generators on `n` qubits, ordered as `CliffordGen::all_generator()`.
+    [[nodiscard]] inline static std::vector<TableauGen> all_generator(std::size_t n) {
+        std::vector<circ::CliffordGenOp> ops{circ::CliffordGenOp::I, circ::CliffordGenOp::HP, circ::CliffordGenOp::PH};
+        std::vector<TableauGen> result;
+        for (auto [op1, op2] : vw::cartesian_product(ops, ops)) {
+            for (auto [a, b] : vw::cartesian_product(vw::ints(0ul, n), vw::ints(0ul, n))) {
+                if (a == b) { continue; }
+                auto& gen = result.emplace_back(TableauGen{.qubits = {a, b}, .gates = {}});
+                emit_local(gen.gates, op1, QIdx(a));
+                emit_local(gen.gates, op2, QIdx(b));
+                gen.gates.emplace_back(circ::gate::Gate2(circ::gate::Gate2::CX{}, QIdx(a), QIdx(b)));
+            }
+        }
+        return result;
+    }
+};
+
+// IDA* synthesis: generators are applied to T⁻¹ until it becomes a product of locals and a permutation M, so that
+// T = M⁻¹ · product(gens). Memory is O(depth) and every query stops at its budget.
+// Lower bounds, all admissible since a generator only touches the rows of two qubits:
+//  - row qubits whose block support is not a single column qubit, two per generator;
+//  - for each column qubit, the number of row qubits touching it minus one, at most one per generator;
+//  - with a table reaching distance k, the distance of the class, or k + 1 when it is not stored; a depth table gives
+//    depths, which bound generator counts from below as well.
+// The table is only consulted on the whole matrix, never on sub-blocks: a k-qubit restriction of a residual is not
+// symplectic, and even a block-diagonal one may be cheaper to finish with the other qubits as workspace, so a table
+// distance over a restriction is not known to be admissible.
+// A `Tableau` of any width is searched over `TableauGen`s with the support bounds, and the table bound only applies
+// when it has N qubits.
+template <std::size_t N>
+class IdaStar {
+    const SynthesisTable<N>* table;
+    std::vector<circ::CliffordGen<N>> all_gen = circ::CliffordGen<N>::all_generator();
+    std::size_t table_depth = 0;
+
+    IdaBudget budget;
+    std::chrono::steady_clock::time_point deadline;
+    std::size_t nodes = 0;
+    std::vector<std::size_t> path;
+
+   public:
+    inline explicit IdaStar(const SynthesisTable<N>* table = nullptr) : table(table) {
+        if (table != nullptr) { table_depth = table->max_distance(); }
+    }
+
+    [[nodiscard]] inline std::size_t expanded() const noexcept { return nodes; }
+
+    [[nodiscard]] inline std::size_t lower_bound(const BitSymplectic<N>& matrix) const noexcept {
+        auto support = block_support(matrix);
+        auto bound = support_bound(N, [&](auto i, auto j) { return support[i * 2 * N + j]; });
+        return table == nullptr ? bound : std::max(bound, table_bound(matrix));
+    }
+    [[nodiscard]] inline std::size_t lower_bound(const Tableau& matrix) const noexcept {
+        auto n = matrix.nqubits();
+        auto bound = support_bound(n, [&](auto i, auto j) {
+            return matrix.get(i, j) || matrix.get(i, j + n) || matrix.get(i + n, j) || matrix.get(i + n, j + n);
+        });
+        if (table == nullptr || n != N) { return bound; }
+        std::array<std::size_t, N> all{};
+        std::iota(all.begin(), all.end(), 0ul);
+        return std::max(bound, table_bound(matrix.restrict<N>(all, all)));
+    }
+
+    [[nodiscard]] inline std::optional<Synthesis<N>> synthesize(BitSymplectic<N> target, IdaBudget budget = {}) {
+        auto start = target.inverse();
+        if (!search(start, std::span<const circ::CliffordGen<N>>(all_gen), budget)) { return std::nullopt; }
+
+        Synthesis<N> result;
+        auto reduced = start;
+        for (auto g : path) {
+            result.gens.push_back(all_gen[g]);
+            reduced = all_gen[g] * reduced;
+        }
+        auto monomial = monomial_decompose(reduced.inverse());
+        assert(monomial.has_value());
+        result.left_perm = monomial->first;
+        result.left_sym = monomial->second;
+        result.right_perm = circ::CircPerm::identity();
+        assert(result.matrix() == target);
+        return result;
+    }
+
+    // M⁻¹ = P · L is read off its blocks: column qubit q has one nonzero block, in row qubit perm[q], which is the local
+    // on qubit q.
+    [[nodiscard]] inline std::optional<LargeSynthesis> synthesize(const Tableau& target, IdaBudget budget = {}) {
+        auto n = target.nqubits();
+        auto gens = TableauGen::all_generator(n);
+        auto start = target.inverse();
+        if (!search(start, std::span<const TableauGen>(gens), budget)) { return std::nullopt; }
+
+        LargeSynthesis result{.nqubits = n, .gates = {}, .perm = std::vector<QIdx>(n)};
+        auto reduced = start;
+        for (auto g : path) {
+            result.gates.insert(result.gates.end(), gens[g].gates.begin(), gens[g].gates.end());
+            reduced = gens[g] * reduced;
+        }
+        auto monomial = reduced.inverse();
+        for (auto q = 0ul; q < n; q++) {
+            auto r = *rgs::find_if(vw::ints(0ul, n), [&](auto r) { return monomial.get(r, q) || monomial.get(r, q + n); });
+            result.perm[q] = QIdx(r);
+            for (auto op : circ::Symmetry3::all()) {
+                std::vector<circ::gate::Gate> local;
+                emit_local(local, op, 0);
+                auto block = Tableau::identity(1);
+                for (const auto& gate : local) {
+                    block.do_mul_l(gate);
+                }
+                auto same = true;
+                for (auto i = 0ul; i < 4; i++) {
+                    same = same && block.get(i / 2, i % 2) == monomial.get(r + i / 2 * n, q + i % 2 * n);
+                }
+                if (same) {
+                    emit_local(result.gates, op, QIdx(q));
+                    break;
+                }
+            }
+        }
+        assert(result.matrix() == target);
+        return result;
+    }
+
+   private:
+    // Support bounds, where `block(i, j)` tells whether row qubit i touches column qubit j.
+    template <typename F>
+    [[nodiscard]] inline static std::size_t support_bound(std::size_t n, F&& block) noexcept {
+        auto unfinished = 0ul;
+        auto column_excess = 0ul;
+        for (auto i = 0ul; i < n; i++) {
+            auto row = rgs::count_if(vw::ints(0ul, n), [&](auto c) { return block(i, c); });
+            auto column = rgs::count_if(vw::ints(0ul, n), [&](auto r) { return block(r, i); });
+            unfinished += row != 1;
+            column_excess = std::max(column_excess, std::size_t(column) - 1);
+        }
+        return std::max((unfinished + 1) / 2, column_excess);
+    }
+    [[nodiscard]] inline std::size_t table_bound(const BitSymplectic<N>& matrix) const noexcept {
+        const auto* entry = table->find(quick_reduce(matrix));
+        return entry == nullptr ? table_depth + 1 : table->distance(*entry);
+    }
+
+    // Deepens the threshold until `path` reaches a product of locals and a permutation; false when out of budget.
+    template <typename Matrix, typename Gen>
+    [[nodiscard]] inline bool search(const Matrix& start, std::span<const Gen> gens, IdaBudget budget) {
+        this->budget = budget;
+        deadline = budget.time_limit == std::chrono::steady_clock::duration::max() ? std::chrono::steady_clock::time_point::max()
+                                                                                   : std::chrono::steady_clock::now() + budget.time_limit;
+        nodes = 0;
+        path.clear();
+        for (auto threshold = lower_bound(start);;) {
+            auto next = dfs(start, gens, threshold);
+            if (next == 0) { return true; }
+            if (next == std::numeric_limits<std::size_t>::max()) { return false; }
+            threshold = next;
+        }
+    }
+
+    // 0 when solved, max when out of budget, otherwise the smallest f above `threshold`.
+    template <typename Matrix, typename Gen>
+    [[nodiscard]] inline std::size_t dfs(const Matrix& matrix, std::span<const Gen> gens, std::size_t threshold) {
+        auto bound = lower_bound(matrix);
+        if (path.size() + bound > threshold) { return path.size() + bound; }
+        // Only products of locals and a permutation have a bound of 0.
+        if (bound == 0) { return 0; }
+        if (++nodes > budget.max_nodes || ((nodes & 1023) == 0 && std::chrono::steady_clock::now() > deadline)) {
+            return std::numeric_limits<std::size_t>::max();
+        }
+
+        auto next_threshold = std::numeric_limits<std::size_t>::max() - 1;
+        for (auto g : vw::ints(0ul, gens.size())) {
+            // Commuting generators are only tried in ascending order.
+            if (!path.empty() && g < path.back() && gens[g].disjoint(gens[path.back()])) { continue; }
+            path.push_back(g);
+            auto result = dfs(gens[g] * matrix, gens, threshold);
+            if (result == 0) { return 0; }
+            path.pop_back();
+            if (result == std::numeric_limits<std::size_t>::max()) { return result; }
+            next_threshold = std::min(next_threshold, result);
+        }
+        return next_threshold;
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(ida_star) {
+    auto full = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>());
+    auto partial = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>(false, {.max_layers = 2}));
+
+    auto monomial = clfd::BitSymplectic<3>::identity().hadamard_l(0).phase_l(2).swap_l(0, 1).hphaseh_r(1);
+    auto decomposed = clfd::search::monomial_decompose(monomial);
+    CHECK(decomposed.has_value());
+    CHECK_EQ(decomposed->first * (decomposed->second * clfd::BitSymplectic<3>::identity()), monomial);
+    CHECK(!clfd::search::monomial_decompose(monomial.cnot_l(0, 1)).has_value());
+
+    auto plain = clfd::search::IdaStar<3>();
+    auto guided = clfd::search::IdaStar<3>(&partial);
+    for (auto i = 0ul; i < 100ul; i++) {
+        auto target = clfd::BitSymplectic<3>::identity();
+        perform_random_gates(target, 20, clfd::CliffordGate<3>::all_gates(), Bv<2>(0b11));
+        auto distance = full.synthesize(target)->gens.size();
+        CHECK(plain.lower_bound(target.inverse()) <= distance);
+        CHECK(guided.lower_bound(target.inverse()) <= distance);
+        auto synthesis = guided.synthesize(target);
+        CHECK(synthesis.has_value());
+        CHECK_EQ(synthesis->matrix(), target);
+        CHECK_EQ(synthesis->gens.size(), distance);
+        auto large = clfd::Tableau::from(target);
+        CHECK_EQ(guided.lower_bound(large.inverse()), guided.lower_bound(target.inverse()));
+        auto wide = guided.synthesize(large);
+        CHECK(wide.has_value());
+        CHECK_EQ(wide->matrix(), large);
+        CHECK_EQ(wide->cx_count(), distance);
+        if (distance <= 3) {
+            auto unguided = plain.synthesize(target);
+            CHECK(unguided.has_value());
+            CHECK_EQ(unguided->matrix(), target);
+            CHECK_EQ(unguided->gens.size(), distance);
+        }
+    }
+
+    auto gens = clfd::search::TableauGen::all_generator(7);
+    CHECK_EQ(gens.size(), 9ul * 7 * 6);
+    for (auto i = 0ul; i < 10ul; i++) {
+        auto target = clfd::Tableau::identity(7);
+        for (auto j = 0ul; j < 4ul; j++) {
+            target = gens[std::experimental::randint(0ul, gens.size() - 1)] * target;
+        }
+        auto synthesis = plain.synthesize(target);
+        CHECK(synthesis.has_value());
+        CHECK_EQ(synthesis->matrix(), target);
+        CHECK(synthesis->cx_count() <= 4);
+    }
+
+    auto hard = clfd::BitSymplectic<4>::identity();
+    perform_random_gates(hard, 40, clfd::CliffordGate<4>::all_gates(), Bv<2>(0b11));
+    auto limited = clfd::search::IdaStar<4>();
+    auto out_of_budget = limited.synthesize(hard, {.max_nodes = 10});
+    CHECK(!out_of_budget.has_value() || out_of_budget->matrix() == hard);
+    CHECK(limited.expanded() <= 11);
+}
+// NOLINTEND
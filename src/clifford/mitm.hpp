@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/gateset/permutation.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./gate.hpp"
+#include "./synthesis.hpp"
+#include "reduce/quick.hpp"
+#include "reduce/restricted.hpp"
+
+namespace clfd::search {
+
+// Meet-in-the-middle synthesis over a (possibly truncated) table of depth k, reaching distances up to 2k. Suffixes are
+// tree nodes taken one generator per layer, so depth tables are rejected.
+// A target T is split as T = A · B with B = K π X σ for a stored node X, so only `T σ⁻¹ X⁻¹` needs a table lookup:
+// left locals and perms of B are absorbed by A, whose distance does not depend on them. Suffix layers are scanned in
+// increasing depth; the first layer with any hit gives an optimal split, so threads stop at the first hit.
+template <std::size_t N>
+class MeetInMiddle {
+    static constexpr std::size_t CHUNK = 64;
+
+    const SynthesisTable<N>& table;
+    std::vector<circ::CliffordGen<N>> all_gen = circ::CliffordGen<N>::all_generator();
+    std::vector<BitSymplectic<N>> gen_matrices;
+    std::vector<circ::CircPerm> perms = qubit_perms<N>([](auto&&) { return true; });
+    std::vector<BitSymplectic<N>> perm_matrices;
+    std::vector<std::vector<BitSymplectic<N>>> inverses;
+
+   public:
+    inline explicit MeetInMiddle(const SynthesisTable<N>& table) : table(table) {
+        if (table.depth_steps()) { throw std::invalid_argument("Meet-in-the-middle needs a generator-count table"); }
+        gen_matrices = all_gen | vw::transform([](auto gen) { return gen * BitSymplectic<N>::identity(); }) | rgs::to<std::vector>();
+        perm_matrices = perms | vw::transform([](auto perm) { return BitSymplectic<N>::identity() * perm; }) | rgs::to<std::vector>();
+        for (auto layer : vw::ints(0ul, table.nlayers())) {
+            auto& inverse = inverses.emplace_back();
+            for (auto ordinal : vw::ints(0ul, table.layer_size(layer))) {
+                inverse.push_back(Synthesis<N>{.left_perm = circ::CircPerm::identity(),
+                                               .left_sym = circ::Symmetry3N<N>(),
+                                               .gens = table.path(layer, ordinal),
+                                               .right_perm = circ::CircPerm::identity()}.product().inverse());
+            }
+        }
+    }
+
+    [[nodiscard]] inline std::optional<Synthesis<N>> synthesize(BitSymplectic<N> target, std::size_t nthreads = std::thread::hardware_concurrency()) const {
+        if (auto direct = table.synthesize(target)) { return direct; }
+        for (auto layer : vw::ints(0ul, inverses.size())) {
+            if (auto hit = search_layer(target, layer, std::max(nthreads, 1ul))) { return compose(target, layer, hit->first, hit->second); }
+        }
+        return std::nullopt;
+    }
+
+   private:
+    // First (node, perm) of `layer` whose remainder is in the table.
+    [[nodiscard]] inline std::optional<std::pair<std::size_t, std::size_t>> search_layer(BitSymplectic<N> target, std::size_t layer,
+                                                                                        std::size_t nthreads) const {
+        const auto& nodes = inverses[layer];
+        auto next = std::atomic<std::size_t>(0);
+        auto hit = std::atomic<std::size_t>(std::numeric_limits<std::size_t>::max());
+        auto worker = [&] {
+            while (hit.load(std::memory_order_relaxed) == std::numeric_limits<std::size_t>::max()) {
+                auto begin = next.fetch_add(CHUNK);
+                if (begin >= nodes.size()) { return; }
+                for (auto ordinal : vw::ints(begin, std::min(begin + CHUNK, nodes.size()))) {
+                    for (auto p : vw::ints(0ul, perms.size())) {
+                        if (table.find(quick_reduce((target * perm_matrices[p]) * nodes[ordinal])) == nullptr) { continue; }
+                        auto expected = std::numeric_limits<std::size_t>::max();
+                        hit.compare_exchange_strong(expected, ordinal * perms.size() + p);
+                        return;
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (auto i = 1ul; i < nthreads; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (hit == std::numeric_limits<std::size_t>::max()) { return std::nullopt; }
+        return std::pair{hit / perms.size(), hit % perms.size()};
+    }
+
+    // With Y = T σ X⁻¹ = L S A R: T = L S A (R X R⁻¹) (R σ⁻¹), so X's generators are relabeled by R.
+    [[nodiscard]] inline Synthesis<N> compose(BitSymplectic<N> target, std::size_t layer, std::size_t ordinal, std::size_t p) const {
+        auto head = table.synthesize((target * perm_matrices[p]) * inverses[layer][ordinal]);
+        assert(head.has_value());
+        auto relabel = BitSymplectic<N>::identity() * head->right_perm;
+        Synthesis<N> result{.left_perm = head->left_perm, .left_sym = head->left_sym, .gens = {}, .right_perm = circ::CircPerm::identity()};
+        for (auto gen : table.path(layer, ordinal)) {
+            auto conjugated = (relabel * (gen * BitSymplectic<N>::identity())) * relabel.inverse();
+            result.gens.push_back(all_gen[std::size_t(rgs::find(gen_matrices, conjugated) - gen_matrices.begin())]);
+        }
+        result.gens.insert(result.gens.end(), head->gens.begin(), head->gens.end());
+        auto right = relabel * perm_matrices[p].inverse();
+        result.right_perm = perms[std::size_t(rgs::find(perm_matrices, right) - perm_matrices.begin())];
+        assert(result.matrix() == target);
+        return result;
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(meet_in_middle) {
+    auto full = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>());
+    auto partial = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>(false, {.max_layers = 2}));
+    auto mitm = clfd::search::MeetInMiddle<3>(partial);
+    CHECK_THROWS(clfd::search::MeetInMiddle<3>(clfd::search::SynthesisTable<3>::build(clfd::search::search_depth<3>(false, 1))));
+    for (auto i = 0ul; i < 300ul; i++) {
+        auto target = clfd::BitSymplectic<3>::identity();
+        perform_random_gates(target, 20, clfd::CliffordGate<3>::all_gates(), Bv<2>(0b11));
+        auto synthesis = mitm.synthesize(target, 4);
+        CHECK(synthesis.has_value());
+        CHECK_EQ(synthesis->matrix(), target);
+        CHECK_EQ(synthesis->gens.size(), full.synthesize(target)->gens.size());
+    }
+}
+// NOLINTEND
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./rules.hpp"
+#include "./synthesis.hpp"
+#include "reduce/quick.hpp"
+
+namespace clfd::search {
+
+// Whether `matrix` is a product of single-qubit Cliffords, without any qubit permutation.
+template <std::size_t N>
+[[nodiscard]] inline bool is_local(const BitSymplectic<N>& matrix) noexcept {
+    for (auto q = 0ul; q < N; q++) {
+        auto block = Bv<2 * N>::zero().update(q, true).update(q + N, true);
+        if ((matrix.xrow(q) & ~block) != Bv<2 * N>::zero() || (matrix.zrow(q) & ~block) != Bv<2 * N>::zero()) { return false; }
+    }
+    return true;
+}
+
+// `matrix` with qubit `q` renamed to `perm[q]`.
+template <std::size_t N>
+[[nodiscard]] inline BitSymplectic<N> relabeled(const BitSymplectic<N>& matrix, const std::array<QIdx, N>& perm) noexcept {
+    auto at = [&perm](std::size_t i) { return i < N ? std::size_t(perm[i]) : std::size_t(perm[i - N]) + N; };
+    std::array<Bv<2 * N>, 2 * N> rows;
+    for (auto i = 0ul; i < 2 * N; i++) {
+        auto row = Bv<2 * N>::zero();
+        for (auto j = 0ul; j < 2 * N; j++) {
+            row = row.update(at(j), matrix.get(i, j));
+        }
+        rows[at(i)] = row;
+    }
+    return BitSymplectic<N>::from_array(rows);
+}
+
+// Peephole rewriting of generator sequences with the length-reducing rules of a `RuleDatabase`.
+//
+// Gates are streamed into an output buffer behind a frame of single-qubit Cliffords and a qubit permutation, so
+// `product(input) == frame · product(output)` at all times: an incoming gate is conjugated through the frame and becomes a
+// generator again. After each append, rules are matched backwards from the last gate through a trie keyed by generators
+// with qubits renamed in order of appearance. Gates disjoint from everything matched so far commute past the window and
+// are skipped, within `lookback` gates. A match is replaced by the rule's circuit, whose own frame joins the output
+// frame, and the skipped gates are streamed in again, so rewrites cascade until no rule applies at the tail.
+template <std::size_t N>
+class PeepholeOptimizer {
+    struct Rule {
+        BitSymplectic<N> frame;
+        std::vector<circ::CliffordGen<N>> gens;
+        std::size_t lhs_size;
+    };
+    struct Node {
+        std::vector<std::pair<std::uint8_t, std::uint32_t>> children;  // sorted by generator index
+        std::optional<std::uint32_t> rule;
+    };
+    struct Match {
+        std::uint32_t rule;
+        std::size_t length;
+        std::array<QIdx, N> qubits;  // rule qubit to circuit qubit
+    };
+
+    std::vector<circ::CliffordGen<N>> all_gen = circ::CliffordGen<N>::all_generator();
+    std::vector<BitSymplectic<N>> gen_inverse;
+    std::vector<Rule> rules;
+    std::vector<Node> trie{Node{}};
+    std::size_t lookback;
+
+   public:
+    inline explicit PeepholeOptimizer(const RuleDatabase<N>& database, std::size_t lookback = 32) : lookback(lookback) {
+        for (auto gen : all_gen) {
+            gen_inverse.push_back((gen * BitSymplectic<N>::identity()).inverse());
+        }
+        for (auto i = 0ul; i < database.size(); i++) {
+            add(database.lhs(i), database.rhs(i));
+        }
+    }
+
+    [[nodiscard]] inline std::size_t size() const noexcept { return rules.size(); }
+
+    // An equivalent circuit with no more generators than `circuit`; its right permutation is the identity unless the
+    // final frame is ambiguous.
+    [[nodiscard]] inline Synthesis<N> optimize(std::span<const circ::CliffordGen<N>> circuit) const {
+        std::vector<circ::CliffordGen<N>> output;
+        auto frame = BitSymplectic<N>::identity();
+        auto target = BitSymplectic<N>::identity();
+        for (auto gen : circuit) {
+            target = gen * target;
+            auto [next, local] = push(gen, frame);
+            frame = frame * local * absorb(output, next);
+        }
+        Synthesis<N> result;
+        result.gens = std::move(output);
+        auto witness = quick_reduce_backtrack(result.product(), target);
+        result.left_perm = witness.left_perm;
+        result.left_sym = witness.left_sym;
+        result.right_perm = witness.right_perm;
+        return result;
+    }
+
+   private:
+    // The generator `h` and local `L` with `gen · frame == frame · L · h`.
+    [[nodiscard]] inline std::pair<circ::CliffordGen<N>, BitSymplectic<N>> push(circ::CliffordGen<N> gen,
+                                                                               const BitSymplectic<N>& frame) const noexcept {
+        auto conjugated = frame.inverse() * (gen * frame);
+        std::array<QIdx, 2> pair{};
+        auto found = 0ul;
+        for (auto q = 0ul; q < N; q++) {
+            auto block = Bv<2 * N>::zero().update(q, true).update(q + N, true);
+            if (((conjugated.xrow(q) | conjugated.zrow(q)) & ~block) != Bv<2 * N>::zero()) { pair[found++] = QIdx(q); }
+        }
+        assert(found == 2);
+        for (auto op : vw::ints(0ul, 9ul)) {
+            for (auto [a, b] : {pair, std::array{pair[1], pair[0]}}) {
+                auto candidate = circ::CliffordGen<N>(circ::CliffordGenOp(op / 3), circ::CliffordGenOp(op % 3), a, b);
+                auto local = conjugated * gen_inverse[candidate.index()];
+                if (is_local(local)) { return {candidate, local}; }
+            }
+        }
+        assert(false && "generators are not closed under local frames");
+        __builtin_unreachable();
+    }
+
+    // Streams `gens`, given inside `frame`, into `output` and returns the frame that ends up outside all of them.
+    [[nodiscard]] inline BitSymplectic<N> stream(std::vector<circ::CliffordGen<N>>& output, std::span<const circ::CliffordGen<N>> gens,
+                                                 BitSymplectic<N> frame) const {
+        for (auto gen : gens) {
+            auto [next, local] = push(gen, frame);
+            frame = frame * local * absorb(output, next);
+        }
+        return frame;
+    }
+
+    // Appends `gen` and rewrites the tail; returns `F` with `gen · old == F · new` for the output products.
+    [[nodiscard]] inline BitSymplectic<N> absorb(std::vector<circ::CliffordGen<N>>& output, circ::CliffordGen<N> gen) const {
+        output.push_back(gen);
+        auto match = find_match(output);
+        if (!match) { return BitSymplectic<N>::identity(); }
+
+        // Split the tail into the matched window and the skipped gates, which commute past it.
+        std::vector<circ::CliffordGen<N>> skipped;
+        auto start = output.size();
+        auto matched = 0ul;
+        std::array<bool, N> touched{};
+        while (matched < match->length) {
+            auto g = output[--start];
+            if (matched == 0 || touched[g.ictrl()] || touched[g.inot()]) {
+                touched[g.ictrl()] = touched[g.inot()] = true;
+                matched++;
+            } else {
+                skipped.push_back(g);
+            }
+        }
+        output.resize(start);
+        std::ranges::reverse(skipped);
+
+        const auto& rule = rules[match->rule];
+        auto gens = rule.gens | vw::transform([&](auto g) { return g.with_bits({match->qubits[g.ictrl()], match->qubits[g.inot()]}); }) |
+                    rgs::to<std::vector>();
+        auto frame = relabeled(rule.frame, match->qubits) * stream(output, gens, BitSymplectic<N>::identity());
+        return stream(output, skipped, frame);
+    }
+
+    // The most reducing rule whose left-hand side can be commuted to the end of `output`.
+    [[nodiscard]] inline std::optional<Match> find_match(const std::vector<circ::CliffordGen<N>>& output) const noexcept {
+        std::array<std::optional<QIdx>, N> names{};
+        std::array<bool, N> touched{};
+        auto next = QIdx(0);
+        auto node = 0u;
+        auto length = 0ul;
+        std::optional<Match> best;
+        for (auto pos = output.size(); pos-- > 0 && output.size() - pos <= lookback;) {
+            auto g = output[pos];
+            if (length > 0 && !touched[g.ictrl()] && !touched[g.inot()]) { continue; }
+            for (auto q : g.bits()) {
+                if (!names[q]) { names[q] = next++; }
+                touched[q] = true;
+            }
+            auto key = std::uint8_t(g.with_bits({*names[g.ictrl()], *names[g.inot()]}).index());
+            const auto& children = trie[node].children;
+            auto it = std::ranges::lower_bound(children, key, {}, &std::pair<std::uint8_t, std::uint32_t>::first);
+            if (it == children.end() || it->first != key) { break; }
+            node = it->second;
+            length++;
+            if (auto rule = trie[node].rule) {
+                if (!best || rules[*rule].lhs_size - rules[*rule].gens.size() > rules[best->rule].lhs_size - rules[best->rule].gens.size()) {
+                    best = Match{.rule = *rule, .length = length, .qubits = complete(names)};
+                }
+            }
+        }
+        return best;
+    }
+
+    // Extends a partial renaming from circuit qubits to rule qubits into the inverse permutation.
+    [[nodiscard]] inline static std::array<QIdx, N> complete(const std::array<std::optional<QIdx>, N>& names) noexcept {
+        std::array<QIdx, N> result{};
+        std::array<bool, N> used{};
+        for (auto q = 0ul; q < N; q++) {
+            if (names[q]) {
+                result[*names[q]] = QIdx(q);
+                used[*names[q]] = true;
+            }
+        }
+        auto free = 0ul;
+        for (auto q = 0ul; q < N; q++) {
+            if (names[q]) { continue; }
+            while (used[free]) { free++; }
+            result[free] = QIdx(q);
+            used[free] = true;
+        }
+        return result;
+    }
+
+    // Keeps rules that shorten the circuit and act only on the qubits of their left-hand side, renamed in order of
+    // appearance from the last gate.
+    inline void add(const std::vector<circ::CliffordGen<N>>& lhs, const Synthesis<N>& rhs) {
+        if (rhs.gens.size() >= lhs.size()) { return; }
+        std::array<std::optional<QIdx>, N> names{};
+        auto next = QIdx(0);
+        for (auto i = lhs.size(); i-- > 0;) {
+            for (auto q : lhs[i].bits()) {
+                if (!names[q]) { names[q] = next++; }
+            }
+        }
+
+        // `lhs == left · right_perm · product(rhs.gens)` becomes `frame · product(gens)` with the frame outermost.
+        auto left = rhs.left_perm * (rhs.left_sym * BitSymplectic<N>::identity());
+        std::vector<circ::CliffordGen<N>> gens;
+        auto frame = BitSymplectic<N>::identity() * rhs.right_perm;
+        for (auto g : rhs.gens) {
+            auto [h, local] = push(g, frame);
+            frame = frame * local;
+            gens.push_back(h);
+        }
+        frame = left * frame;
+        auto identity = BitSymplectic<N>::identity();
+        for (auto q = 0ul; q < N; q++) {
+            if (names[q]) { continue; }
+            if (frame.xrow(q) != identity.xrow(q) || frame.zrow(q) != identity.zrow(q) || frame.xcol(q) != identity.xcol(q) ||
+                frame.zcol(q) != identity.zcol(q)) {
+                return;
+            }
+            if (rgs::any_of(gens, [q](auto g) { return g.ictrl() == q || g.inot() == q; })) { return; }
+        }
+
+        auto perm = complete(names);
+        std::array<QIdx, N> rename{};
+        for (auto q = 0ul; q < N; q++) {
+            rename[perm[q]] = QIdx(q);
+        }
+        auto node = 0u;
+        for (auto i = lhs.size(); i-- > 0;) {
+            auto g = lhs[i];
+            auto key = std::uint8_t(g.with_bits({rename[g.ictrl()], rename[g.inot()]}).index());
+            auto& children = trie[node].children;
+            auto it = std::ranges::lower_bound(children, key, {}, &std::pair<std::uint8_t, std::uint32_t>::first);
+            if (it == children.end() || it->first != key) {
+                it = children.insert(it, {key, std::uint32_t(trie.size())});
+                node = it->second;
+                trie.emplace_back();
+            } else {
+                node = it->second;
+            }
+        }
+        auto renamed = gens | vw::transform([&](auto g) { return g.with_bits({rename[g.ictrl()], rename[g.inot()]}); }) | rgs::to<std::vector>();
+        if (trie[node].rule && rules[*trie[node].rule].gens.size() <= renamed.size()) { return; }
+        auto rule = Rule{.frame = relabeled(frame, rename), .gens = std::move(renamed), .lhs_size = lhs.size()};
+        if (trie[node].rule) {
+            rules[*trie[node].rule] = std::move(rule);
+        } else {
+            trie[node].rule = std::uint32_t(rules.size());
+            rules.push_back(std::move(rule));
+        }
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(peephole) {
+    using Gen = circ::CliffordGen<4>;
+    auto table = clfd::search::SynthesisTable<4>::build(clfd::search::search<4>(false, {.max_layers = 3}));
+    auto optimizer = clfd::search::PeepholeOptimizer<4>(clfd::search::RuleDatabase<4>::mine(table, false));
+    CHECK(optimizer.size() > 0);
+
+    auto product = [](std::span<const Gen> gens) {
+        auto result = clfd::BitSymplectic<4>::identity();
+        for (auto gen : gens) {
+            result = gen * result;
+        }
+        return result;
+    };
+    // A CX undone across a gate on the other two qubits. Rules from a one-layer table have two-gate left-hand sides, so
+    // only skipping the disjoint gate finds the match.
+    auto pairs = clfd::search::SynthesisTable<4>::build(clfd::search::search<4>(false, {.max_layers = 1}));
+    auto pair_optimizer = clfd::search::PeepholeOptimizer<4>(clfd::search::RuleDatabase<4>::mine(pairs, false));
+    auto cx = Gen(circ::CliffordGenOp::I, circ::CliffordGenOp::I, 0, 1);
+    std::vector<Gen> circuit{cx, Gen::iph_cx(2, 3), cx};
+    auto result = pair_optimizer.optimize(circuit);
+    CHECK_EQ(result.matrix(), product(circuit));
+    CHECK_EQ(result.gens.size(), circuit.size() - 2);
+
+    auto all_gen = Gen::all_generator();
+    auto before = 0ul, after = 0ul;
+    for (auto i = 0ul; i < 50ul; i++) {
+        std::vector<Gen> gens;
+        for (auto j = 0ul; j < 60ul; j++) {
+            gens.push_back(all_gen[std::experimental::randint(0ul, all_gen.size() - 1)]);
+        }
+        auto optimized = optimizer.optimize(gens);
+        CHECK_EQ(optimized.matrix(), product(gens));
+        CHECK(optimized.gens.size() <= gens.size());
+        before += gens.size();
+        after += optimized.gens.size();
+    }
+    CHECK(after < before);
+}
+// NOLINTEND
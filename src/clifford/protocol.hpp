@@ -0,0 +1,199 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/gateset/permutation.hpp"
+#include "../circuit/gateset/symmetry3.hpp"
+#include "./bitsymplectic.hpp"
+#include "./synthesis.hpp"
+
+// Binary protocol of the table daemon. Both ends run on the same host, so fields are in native byte order.
+// A request is a header followed by `count` targets of two 64-bit words, `BitSymplectic::as_raw()`. A response is a header
+// followed by `bytes` of records, one per target:
+//  - Distance: one byte, the distance or `NOT_FOUND` / `INVALID`;
+//  - Synthesize: one byte with the number of generators or `NOT_FOUND` / `INVALID`, then the left permutation, left
+//    locals and right permutation as three 16-bit words, then one byte per generator;
+//  - Stats: a single `StatsRecord`.
+namespace clfd::protocol {
+
+constexpr std::uint32_t MAGIC = 0x434c4631;  // "CLF1"
+constexpr std::uint8_t NOT_FOUND = 0xff;
+constexpr std::uint8_t INVALID = 0xfe;
+
+enum class Kind : std::uint8_t { Distance = 1, Synthesize = 2, Stats = 3 };
+enum class Status : std::uint8_t { Ok = 0, NoTable = 1, BadRequest = 2 };
+
+struct RequestHeader {
+    std::uint32_t magic = MAGIC;
+    Kind kind;
+    std::uint8_t nqubits;
+    std::uint16_t reserved = 0;
+    std::uint32_t count;
+};
+static_assert(sizeof(RequestHeader) == 12);
+
+struct ResponseHeader {
+    std::uint32_t magic = MAGIC;
+    Kind kind;
+    Status status;
+    std::uint16_t reserved = 0;
+    std::uint32_t count;
+    std::uint32_t bytes;
+};
+static_assert(sizeof(ResponseHeader) == 16);
+
+// Latencies are per request and rounded up to a power of two nanoseconds.
+struct StatsRecord {
+    std::uint64_t requests;
+    std::uint64_t queries;
+    std::uint64_t p50_ns;
+    std::uint64_t p90_ns;
+    std::uint64_t p99_ns;
+    std::uint64_t max_ns;
+};
+
+inline void read_full(int fd, void* data, std::size_t size) {
+    auto* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        auto n = ::read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n < 0) { throw std::system_error(errno, std::generic_category(), "read"); }
+        if (n == 0) { throw std::system_error(std::make_error_code(std::errc::connection_reset), "read"); }
+        bytes += n;
+        size -= std::size_t(n);
+    }
+}
+inline void write_full(int fd, const void* data, std::size_t size) {
+    const auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        auto n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n < 0) { throw std::system_error(errno, std::generic_category(), "write"); }
+        bytes += n;
+        size -= std::size_t(n);
+    }
+}
+
+[[nodiscard]] inline sockaddr_un socket_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) { throw std::system_error(std::make_error_code(std::errc::filename_too_long), path); }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+template <typename T>
+inline void append(std::vector<std::byte>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const std::byte*>(&value);  // NOLINT
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+template <typename T>
+[[nodiscard]] inline T take(std::span<const std::byte>& in) {
+    T value;
+    std::memcpy(&value, in.data(), sizeof(T));
+    in = in.subspan(sizeof(T));
+    return value;
+}
+
+template <std::size_t N>
+inline void encode_synthesis(std::vector<std::byte>& out, const search::Synthesis<N>& synthesis) {
+    append(out, std::uint8_t(synthesis.gens.size()));
+    append(out, std::uint16_t(synthesis.left_perm.vec().uint()));
+    append(out, synthesis.left_sym.data);
+    append(out, std::uint16_t(synthesis.right_perm.vec().uint()));
+    for (auto gen : synthesis.gens) {
+        append(out, std::uint8_t((std::uint8_t(gen.op_ctrl()) * 5 + gen.ictrl()) | (std::uint8_t(gen.op_not()) * 5 + gen.inot()) << 4));
+    }
+}
+template <std::size_t N>
+[[nodiscard]] inline std::optional<search::Synthesis<N>> decode_synthesis(std::span<const std::byte>& in) {
+    auto size = take<std::uint8_t>(in);
+    if (size == NOT_FOUND || size == INVALID) { return std::nullopt; }
+    search::Synthesis<N> result;
+    result.left_perm = circ::CircPerm(Bv<15>(take<std::uint16_t>(in)));
+    result.left_sym = circ::Symmetry3N<N>(take<std::uint16_t>(in));
+    result.right_perm = circ::CircPerm(Bv<15>(take<std::uint16_t>(in)));
+    for (auto i = 0u; i < size; i++) {
+        auto byte = take<std::uint8_t>(in);
+        auto q1 = byte & 0xf;
+        auto q2 = byte >> 4;
+        result.gens.emplace_back(circ::CliffordGenOp(q1 / 5), circ::CliffordGenOp(q2 / 5), QIdx(q1 % 5), QIdx(q2 % 5));
+    }
+    return result;
+}
+
+// One connection to the daemon; queries block until their response arrives.
+class Client {
+    int fd;
+
+   public:
+    inline explicit Client(const std::string& path) : fd(::socket(AF_UNIX, SOCK_STREAM, 0)) {
+        if (fd < 0) { throw std::system_error(errno, std::generic_category(), "socket"); }
+        auto address = socket_address(path);
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {  // NOLINT
+            auto error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "connect " + path);
+        }
+    }
+    inline ~Client() { ::close(fd); }
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    // Distances in CX count, or `NOT_FOUND` / `INVALID`.
+    template <std::size_t N>
+    [[nodiscard]] inline std::vector<std::uint8_t> distance(std::span<const BitSymplectic<N>> targets) {
+        auto payload = query(Kind::Distance, N, targets);
+        return payload | vw::transform([](auto b) { return std::uint8_t(b); }) | rgs::to<std::vector>();
+    }
+    template <std::size_t N>
+    [[nodiscard]] inline std::vector<std::optional<search::Synthesis<N>>> synthesize(std::span<const BitSymplectic<N>> targets) {
+        auto payload = query(Kind::Synthesize, N, targets);
+        auto in = std::span<const std::byte>(payload);
+        std::vector<std::optional<search::Synthesis<N>>> result;
+        while (!in.empty()) {
+            result.push_back(decode_synthesis<N>(in));
+        }
+        return result;
+    }
+    [[nodiscard]] inline StatsRecord stats() {
+        auto payload = query<1>(Kind::Stats, 0, {});
+        auto in = std::span<const std::byte>(payload);
+        return take<StatsRecord>(in);
+    }
+
+   private:
+    template <std::size_t N>
+    [[nodiscard]] inline std::vector<std::byte> query(Kind kind, std::size_t nqubits, std::span<const BitSymplectic<N>> targets) {
+        std::vector<std::byte> request;
+        append(request, RequestHeader{.kind = kind, .nqubits = std::uint8_t(nqubits), .count = std::uint32_t(targets.size())});
+        for (const auto& target : targets) {
+            auto [x, z] = target.as_raw();
+            append(request, x);
+            append(request, z);
+        }
+        write_full(fd, request.data(), request.size());
+
+        ResponseHeader header;
+        read_full(fd, &header, sizeof(header));
+        if (header.magic != MAGIC || header.status != Status::Ok) {
+            throw std::system_error(std::make_error_code(std::errc::protocol_error), "daemon status " + std::to_string(int(header.status)));
+        }
+        std::vector<std::byte> payload(header.bytes);
+        read_full(fd, payload.data(), payload.size());
+        return payload;
+    }
+};
+
+}  // namespace clfd::protocol
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <numeric>
+#include <set>
+#include <span>
+#include <vector>
+#include "../../circuit/gateset/permutation.hpp"
+#include "../../utils/math.hpp"
+#include "../gate.hpp"
+#include "left.hpp"
+#include "quick.hpp"
+
+namespace clfd {
+
+// All relabelings of N qubits accepted by `pred`. Callers pass predicates closed under composition (e.g. "preserves
+// a cost table"), so the result is a group.
+template <std::size_t N, typename PredF>
+[[nodiscard]] inline std::vector<circ::CircPerm> qubit_perms(PredF&& pred) {
+    std::array<QIdx, N> perm;
+    std::iota(perm.begin(), perm.end(), QIdx(0));
+    std::vector<circ::CircPerm> result;
+    do {
+        if (pred(perm)) { result.push_back(circ::CircPerm::from(perm)); }
+    } while (std::next_permutation(perm.begin(), perm.end()));
+    return result;
+}
+
+// Canonical form under left local Cliffords and a permutation group applied independently on both sides.
+// `quick_reduce` covers the full symmetric group; this brute-forces |group|^2 candidates for small groups.
+template <std::size_t N>
+[[nodiscard]] inline constexpr BitSymplectic<N> restricted_reduce(BitSymplectic<N> input, std::span<const circ::CircPerm> group) noexcept {
+    auto result = left_reduce(input);
+    for (auto right : group) {
+        auto reduced = left_reduce(input * right);
+        for (auto left : group) {
+            result = std::min(result, left * reduced);
+        }
+    }
+    return result;
+}
+
+template <std::size_t N>
+[[nodiscard]] inline constexpr std::size_t restricted_reduce_eqcount(BitSymplectic<N> input, std::span<const circ::CircPerm> group) noexcept {
+    auto reduced = left_reduce(input);
+    std::size_t aut = 0;
+    for (auto right : group) {
+        auto matrix = left_reduce(input * right);
+        for (auto left : group) {
+            if (left * matrix == reduced) { aut += 1; }
+        }
+    }
+    assert(aut > 0);
+    return group.size() * group.size() * utils::power(6, N) / aut;
+}
+
+// Canonical form under a permutation group applied independently on both sides, without the left local Cliffords.
+template <std::size_t N>
+[[nodiscard]] inline constexpr BitSymplectic<N> relabel_reduce(BitSymplectic<N> input, std::span<const circ::CircPerm> group) noexcept {
+    auto result = input;
+    for (auto right : group) {
+        auto matrix = input * right;
+        for (auto left : group) {
+            result = std::min(result, left * matrix);
+        }
+    }
+    return result;
+}
+
+template <std::size_t N>
+[[nodiscard]] inline constexpr std::size_t relabel_reduce_eqcount(BitSymplectic<N> input, std::span<const circ::CircPerm> group) noexcept {
+    std::size_t aut = 0;
+    for (auto right : group) {
+        auto matrix = input * right;
+        for (auto left : group) {
+            if (left * matrix == input) { aut += 1; }
+        }
+    }
+    assert(aut > 0);
+    return group.size() * group.size() / aut;
+}
+
+}  // namespace clfd
+
+// NOLINTBEGIN
+TEST_FN(restricted_reduce) {
+    auto all = clfd::qubit_perms<4>([](auto&&) { return true; });
+    CHECK_EQ(all.size(), 24);
+    for (auto i = 0ul; i < 1000ul; i++) {
+        auto original = clfd::BitSymplectic<4>::identity();
+        perform_random_gates(original, 30, clfd::CliffordGate<4>::all_gates(), Bv<2>(0b11));
+        auto reduced = clfd::restricted_reduce(original, all);
+        CHECK_EQ(reduced, clfd::restricted_reduce(clfd::left_reduce(original.swap_l(0, 2).swap_r(1, 3)), all));
+        CHECK_EQ(clfd::restricted_reduce_eqcount(original, all), clfd::quick_reduce_eqcount(original));
+        CHECK_EQ(clfd::relabel_reduce(original, all), clfd::relabel_reduce(original.swap_l(0, 2).swap_r(1, 3), all));
+        CHECK(clfd::relabel_reduce(original, all) <= original);
+    }
+    auto orbit = std::set<clfd::BitSymplectic<4>>();
+    for (auto left : all) {
+        for (auto right : all) {
+            orbit.insert(left * clfd::BitSymplectic<4>::identity() * right);
+        }
+    }
+    CHECK_EQ(clfd::relabel_reduce_eqcount(clfd::BitSymplectic<4>::identity(), all), orbit.size());
+}
+// NOLINTEND
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "../circuit/gateset/gate/gate.hpp"
+#include "../defines.hpp"
+#include "./bitsymplectic.hpp"
+#include "./greedy.hpp"
+#include "./signed.hpp"
+#include "./synthesis.hpp"
+
+namespace clfd::search {
+
+struct Resynthesized {
+    LargeSynthesis circuit;
+    std::size_t blocks = 0;
+    std::size_t replaced = 0;
+    std::size_t cache_hits = 0;
+};
+
+// Peephole resynthesis of the Clifford parts of a circuit. A linear pass groups Clifford gates into blocks on at most N
+// qubits: a block owns its qubits until a gate that cannot join it closes it, and is emitted where it closes, which is
+// valid since no other gate touched its qubits in between. Blocks are then resynthesized independently on `nthreads`
+// threads, each with its own cache from block matrices to table circuits. A block is replaced when the table circuit,
+// Pauli correction included, has fewer two-qubit gates, or as many and fewer gates. Permutations from the table are not
+// emitted as SWAPs: they relabel the rest of the circuit and end up in the result's `perm`.
+template <std::size_t N>
+class Resynthesizer {
+    static constexpr std::size_t CHUNK = 256;
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+    struct Block {
+        std::vector<std::size_t> gates;
+        std::vector<QIdx> qubits;  // sorted, qubit `qubits[i]` is local qubit i
+    };
+    struct Item {
+        bool block;
+        std::size_t index;
+    };
+    // Table circuit of a block matrix with the signs it produces; empty when it would need qubits outside the block.
+    struct Cached {
+        std::optional<LocalCircuit<N>> circuit;
+        Bv<2 * N> signs = Bv<2 * N>::zero();
+    };
+    using Cache = std::array<std::unordered_map<BitSymplectic<N>, Cached>, N + 1>;
+
+    const SynthesisTable<N>& table;
+    std::size_t nthreads;
+
+   public:
+    inline explicit Resynthesizer(const SynthesisTable<N>& table, std::size_t nthreads = std::thread::hardware_concurrency())
+        : table(table), nthreads(std::max(nthreads, 1ul)) {}
+
+    [[nodiscard]] inline static bool is_clifford(const circ::gate::Gate& gate) noexcept {
+        using namespace circ::gate;
+        if (const auto* g1 = std::get_if<Gate1>(&gate)) {
+            return std::visit(
+                []<typename G>(const G&) {
+                    return std::is_same_v<G, Gate1::X> || std::is_same_v<G, Gate1::Y> || std::is_same_v<G, Gate1::Z> ||
+                           std::is_same_v<G, Gate1::H> || std::is_same_v<G, Gate1::S> || std::is_same_v<G, Gate1::SDG> ||
+                           std::is_same_v<G, Gate1::SRN>;
+                },
+                g1->gate);
+        }
+        if (const auto* g2 = std::get_if<Gate2>(&gate)) { return !std::holds_alternative<Gate2::CH>(g2->gate); }
+        return false;
+    }
+
+    [[nodiscard]] inline Resynthesized optimize(std::size_t nqubits, const std::vector<circ::gate::Gate>& circuit) const {
+        std::vector<Block> blocks;
+        auto items = partition(nqubits, circuit, blocks);
+
+        std::vector<std::optional<std::vector<circ::gate::Gate>>> replacements(blocks.size());
+        std::vector<std::array<QIdx, N>> perms(blocks.size());
+        auto next = std::atomic<std::size_t>(0);
+        auto hits = std::atomic<std::size_t>(0);
+        auto worker = [&] {
+            Cache cache;
+            auto local_hits = 0ul;
+            for (auto begin = next.fetch_add(CHUNK); begin < blocks.size(); begin = next.fetch_add(CHUNK)) {
+                for (auto b : vw::ints(begin, std::min(begin + CHUNK, blocks.size()))) {
+                    replacements[b] = resynthesize(circuit, blocks[b], cache, local_hits, perms[b]);
+                }
+            }
+            hits += local_hits;
+        };
+        std::vector<std::thread> threads;
+        for (auto i = 1ul; i < nthreads; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        Resynthesized result{.circuit = {.nqubits = nqubits, .gates = {}, .perm = std::vector<QIdx>(nqubits)}, .cache_hits = hits};
+        std::vector<QIdx> wire(nqubits);  // input qubit q currently lives on output qubit wire[q]
+        std::iota(wire.begin(), wire.end(), QIdx(0));
+        auto& gates = result.circuit.gates;
+        for (auto item : items) {
+            if (!item.block) {
+                gates.push_back(circ::gate::relabeled(circuit[item.index], [&](auto q) { return wire[q]; }));
+                continue;
+            }
+            const auto& block = blocks[item.index];
+            result.blocks += 1;
+            if (!replacements[item.index]) {
+                for (auto g : block.gates) {
+                    gates.push_back(circ::gate::relabeled(circuit[g], [&](auto q) { return wire[q]; }));
+                }
+                continue;
+            }
+            result.replaced += 1;
+            for (const auto& gate : *replacements[item.index]) {
+                gates.push_back(circ::gate::relabeled(gate, [&](auto q) { return wire[block.qubits[q]]; }));
+            }
+            std::array<QIdx, N> before{};
+            for (auto i = 0ul; i < block.qubits.size(); i++) {
+                before[i] = wire[block.qubits[i]];
+            }
+            for (auto i = 0ul; i < block.qubits.size(); i++) {
+                wire[block.qubits[perms[item.index][i]]] = before[i];
+            }
+        }
+        for (auto q = 0ul; q < nqubits; q++) {
+            result.circuit.perm[wire[q]] = QIdx(q);
+        }
+        return result;
+    }
+
+   private:
+    [[nodiscard]] inline static auto qubits_of(const circ::gate::Gate& gate) noexcept {
+        return std::visit([](auto&& g) { return circ::gate::QIdxVec(g.qubits.begin(), g.qubits.end()); }, gate);
+    }
+
+    [[nodiscard]] inline static std::vector<Item> partition(std::size_t nqubits, const std::vector<circ::gate::Gate>& circuit,
+                                                            std::vector<Block>& blocks) {
+        std::vector<Item> items;
+        std::vector<std::size_t> owner(nqubits, NONE);
+        auto close = [&](std::size_t b) {
+            items.push_back({true, b});
+            for (auto q : blocks[b].qubits) {
+                owner[q] = NONE;
+            }
+        };
+        auto joined = [&](std::size_t b, const circ::gate::QIdxVec& qubits) {
+            std::vector<QIdx> result = blocks[b].qubits;
+            for (auto q : qubits) {
+                if (owner[q] != b) { result.push_back(q); }
+            }
+            std::ranges::sort(result);
+            return result;
+        };
+
+        for (auto i = 0ul; i < circuit.size(); i++) {
+            auto qubits = qubits_of(circuit[i]);
+            std::vector<std::size_t> touched;
+            for (auto q : qubits) {
+                if (owner[q] != NONE && rgs::find(touched, owner[q]) == touched.end()) { touched.push_back(owner[q]); }
+            }
+            if (!is_clifford(circuit[i])) {
+                for (auto b : touched) {
+                    close(b);
+                }
+                items.push_back({false, i});
+                continue;
+            }
+
+            // Merge every touched block when they fit together, else keep the largest one that still fits.
+            auto keep = NONE;
+            auto size = qubits.size();
+            for (auto b : touched) {
+                size += blocks[b].qubits.size() - std::size_t(rgs::count_if(qubits, [&](auto q) { return owner[q] == b; }));
+            }
+            if (size <= N && !touched.empty()) {
+                keep = touched[0];
+                for (auto b : touched) {
+                    if (b == keep) { continue; }
+                    auto& other = blocks[b];
+                    blocks[keep].gates.insert(blocks[keep].gates.end(), other.gates.begin(), other.gates.end());
+                    blocks[keep].qubits.insert(blocks[keep].qubits.end(), other.qubits.begin(), other.qubits.end());
+                    for (auto q : other.qubits) {
+                        owner[q] = keep;
+                    }
+                    other = {};
+                }
+                std::ranges::sort(blocks[keep].qubits);
+            } else {
+                for (auto b : touched) {
+                    if (joined(b, qubits).size() <= N && (keep == NONE || blocks[b].gates.size() > blocks[keep].gates.size())) { keep = b; }
+                }
+                for (auto b : touched) {
+                    if (b != keep) { close(b); }
+                }
+            }
+            if (keep == NONE) {
+                keep = blocks.size();
+                blocks.emplace_back();
+            }
+            blocks[keep].qubits = joined(keep, qubits);
+            for (auto q : qubits) {
+                owner[q] = keep;
+            }
+            blocks[keep].gates.push_back(i);
+        }
+        for (auto b = 0ul; b < blocks.size(); b++) {
+            if (!blocks[b].gates.empty() && owner[blocks[b].qubits[0]] == b) { close(b); }
+        }
+        return items;
+    }
+
+    [[nodiscard]] inline std::optional<std::vector<circ::gate::Gate>> resynthesize(const std::vector<circ::gate::Gate>& circuit, const Block& block,
+                                                                                 Cache& cache, std::size_t& hits, std::array<QIdx, N>& perm) const {
+        if (block.gates.size() < 2) { return std::nullopt; }
+        auto target = SignedSymplectic<N>();
+        auto original_2q = 0ul;
+        for (auto g : block.gates) {
+            auto local = [&block](auto q) { return std::ranges::lower_bound(block.qubits, q) - block.qubits.begin(); };
+            target.do_mul_l(circ::gate::relabeled(circuit[g], local));
+            original_2q += std::holds_alternative<circ::gate::Gate2>(circuit[g]);
+        }
+
+        auto k = block.qubits.size();
+        auto [it, inserted] = cache[k].try_emplace(target.matrix);
+        if (inserted) {
+            it->second = lookup(target.matrix, k);
+        } else {
+            hits += 1;
+        }
+        const auto& cached = it->second;
+        if (!cached.circuit) { return std::nullopt; }
+
+        auto gates = cached.circuit->gates;
+        auto computed = SignedSymplectic<N>{target.matrix, cached.signs};
+        auto pauli = computed.pauli_correction(target.signs);
+        for (auto a = 0ul; a < N; a++) {
+            // The correction acts after the relabeling, so it is applied to the qubit that becomes `a`.
+            auto q = QIdx(rgs::find(cached.circuit->perm, QIdx(a)) - cached.circuit->perm.begin());
+            if (pauli[a] && pauli[a + N]) {
+                gates.emplace_back(circ::gate::Gate1::Y{}(q));
+            } else if (pauli[a]) {
+                gates.emplace_back(circ::gate::Gate1::X{}(q));
+            } else if (pauli[a + N]) {
+                gates.emplace_back(circ::gate::Gate1::Z{}(q));
+            }
+        }
+
+        auto replaced_2q = std::size_t(rgs::count_if(gates, [](auto&& gate) { return std::holds_alternative<circ::gate::Gate2>(gate); }));
+        if (replaced_2q > original_2q || (replaced_2q == original_2q && gates.size() >= block.gates.size())) { return std::nullopt; }
+        perm = cached.circuit->perm;
+        return gates;
+    }
+
+    [[nodiscard]] inline Cached lookup(const BitSymplectic<N>& matrix, std::size_t k) const {
+        auto synthesis = table.synthesize(matrix);
+        if (!synthesis) { return {}; }
+        auto circuit = synthesis_circuit(*synthesis);
+        auto outside = [k](auto q) { return q >= k; };
+        for (auto a = k; a < N; a++) {
+            if (circuit.perm[a] != a) { return {}; }
+        }
+        for (const auto& gate : circuit.gates) {
+            if (rgs::any_of(qubits_of(gate), outside)) { return {}; }
+        }
+        auto signs = SignedSymplectic<N>();
+        for (const auto& gate : circuit.gates) {
+            signs.do_mul_l(gate);
+        }
+        signs.do_permute_l(circuit.perm);
+        return {circuit, signs.signs};
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(resynthesis) {
+    using namespace circ::gate;
+    auto table = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>());
+
+    std::vector<Gate> trivial{Gate1::H{}(0), Gate1::H{}(0), Gate1::T{}(0), Gate2(Gate2::CX{}, 0, 1), Gate2(Gate2::CX{}, 0, 1),
+                              Gate1::S{}(1), Gate1::S{}(1), Gate1::S{}(1), Gate1::S{}(1)};
+    auto reduced = clfd::search::Resynthesizer<3>(table, 1).optimize(2, trivial);
+    CHECK_EQ(reduced.circuit.gates, std::vector<Gate>{Gate1::T{}(0)});
+    CHECK_EQ(reduced.blocks, 2);
+    CHECK_EQ(reduced.replaced, 2);
+
+    auto serial = clfd::search::Resynthesizer<3>(table, 1);
+    auto parallel = clfd::search::Resynthesizer<3>(table, 4);
+    for (auto i = 0ul; i < 50ul; i++) {
+        std::vector<Gate> circuit;
+        for (auto j = 0ul; j < 300ul; j++) {
+            auto a = QIdx(std::experimental::randint(0, 4));
+            auto b = QIdx((a + std::experimental::randint(1, 2)) % 5);
+            std::array<Gate, 10> gates{Gate1::H{}(a),   Gate1::S{}(a), Gate1::SDG{}(a), Gate1::X{}(a), Gate1::Z{}(a), Gate1::SRN{}(a),
+                                       Gate2(Gate2::CX{}, a, b), Gate2(Gate2::CZ{}, a, b), Gate2(Gate2::CY{}, a, b), Gate2(Gate2::SWAP{}, a, b)};
+            circuit.push_back(gates[std::experimental::randint(0ul, gates.size() - 1)]);
+        }
+        auto result = serial.optimize(5, circuit);
+        CHECK_EQ(parallel.optimize(5, circuit).circuit.gates, result.circuit.gates);
+
+        auto expected = clfd::SignedSymplectic<5>();
+        for (const auto& gate : circuit) {
+            expected.do_mul_l(gate);
+        }
+        auto actual = clfd::SignedSymplectic<5>();
+        for (const auto& gate : result.circuit.gates) {
+            actual.do_mul_l(gate);
+        }
+        actual.do_permute_l(result.circuit.perm);
+        CHECK_EQ(actual, expected);
+        auto count_2q = [](auto&& gates) { return rgs::count_if(gates, [](auto&& gate) { return std::holds_alternative<Gate2>(gate); }); };
+        CHECK(count_2q(result.circuit.gates) < count_2q(circuit));
+    }
+}
+// NOLINTEND
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/gateset/permutation.hpp"
+#include "../circuit/gateset/symmetry3.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./synthesis.hpp"
+#include "cereal/cereal.hpp"
+#include "cereal/types/vector.hpp"
+#include "reduce/quick.hpp"
+
+namespace clfd::search {
+
+// Circuit equivalences mined from a search tree. Each rule reads `product(lhs) == rhs.matrix()`, where `lhs` is a tree
+// node extended by one generator that the search pruned, and `rhs` is the table's circuit for it, so it is never longer.
+// Generators are stored as their `CliffordGen::index()` byte and rules are sorted by `lhs` for lookup.
+template <std::size_t N>
+class RuleDatabase {
+   public:
+    struct __attribute__((packed)) Record {
+        std::uint32_t offset;  // `lhs` then `rhs` generators in `symbols`
+        std::uint8_t lhs_size;
+        std::uint8_t rhs_size;
+        std::uint16_t left_perm;
+        std::uint16_t left_sym;
+        std::uint16_t right_perm;
+
+        template <typename Archive>
+        void serialize(Archive& archive) {
+            archive(cereal::binary_data(this, sizeof(Record)));
+        }
+    };
+    static_assert(sizeof(Record) == 12);
+
+   private:
+    std::vector<circ::CliffordGen<N>> all_gen = circ::CliffordGen<N>::all_generator();
+    std::vector<std::byte> symbols;
+    std::vector<Record> records;
+
+    struct Mined {
+        std::vector<std::byte> lhs;
+        Synthesis<N> rhs;
+    };
+
+   public:
+    inline explicit RuleDatabase() = default;
+
+    // Extends every node of `table` by every generator on `nthreads` workers. An extension becomes a rule unless it is a
+    // child node, its class lies beyond a truncated tree, or dropping its first generator already gives a shorter
+    // circuit, in which case a rule on that suffix implies it. With `rewrites` off only length-reducing rules are kept.
+    // Rules shorten generator counts, so depth tables, whose nodes are half steps, are rejected.
+    [[nodiscard]] inline static RuleDatabase mine(const SynthesisTable<N>& table, bool rewrites = true,
+                                                  std::size_t nthreads = std::thread::hardware_concurrency()) {
+        if (table.depth_steps()) { throw std::invalid_argument("Rules are mined from generator-count tables"); }
+        const auto& index = table.tree_index();
+        auto all_gen = circ::CliffordGen<N>::all_generator();
+        auto distance = [&table](BitSymplectic<N> matrix) -> std::optional<std::size_t> {
+            const auto* entry = table.find(quick_reduce(matrix));
+            if (entry == nullptr) { return std::nullopt; }
+            return table.distance(*entry);
+        };
+
+        std::vector<std::pair<std::size_t, std::size_t>> nodes;
+        for (auto layer : vw::ints(0ul, table.nlayers())) {
+            for (auto ordinal : vw::ints(0ul, table.layer_size(layer))) {
+                nodes.emplace_back(layer, ordinal);
+            }
+        }
+        std::vector<std::vector<Mined>> found(std::max(nthreads, 1ul));
+        auto next = std::atomic<std::size_t>(0);
+        auto worker = [&](std::vector<Mined>& out) {
+            std::vector<bool> child(all_gen.size());
+            for (auto i = next++; i < nodes.size(); i = next++) {
+                auto [layer, ordinal] = nodes[i];
+                auto path = index.path(layer, ordinal);
+                auto product = BitSymplectic<N>::identity();
+                auto suffix = BitSymplectic<N>::identity();
+                for (auto j = 0ul; j < path.size(); j++) {
+                    product = all_gen[std::size_t(path[j])] * product;
+                    if (j > 0) { suffix = all_gen[std::size_t(path[j])] * suffix; }
+                }
+                std::fill(child.begin(), child.end(), false);
+                auto [first, last] = index.children(layer, ordinal);
+                for (auto c = first; c < last; c++) {
+                    child[std::size_t(index.node(layer + 1, c))] = true;
+                }
+
+                for (auto g = 0ul; g < all_gen.size(); g++) {
+                    if (child[g]) { continue; }
+                    auto extended = all_gen[g] * product;
+                    auto length = distance(extended);
+                    if (!length || (!rewrites && *length == path.size() + 1)) { continue; }
+                    auto shorter = distance(all_gen[g] * suffix);
+                    if (shorter && *shorter < path.size()) { continue; }
+                    auto& rule = out.emplace_back(Mined{.lhs = path, .rhs = *table.synthesize(extended)});
+                    rule.lhs.push_back(std::byte(g));
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (auto t = 1ul; t < found.size(); t++) {
+            threads.emplace_back(worker, std::ref(found[t]));
+        }
+        worker(found[0]);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        std::vector<Mined> rules;
+        for (auto& part : found) {
+            std::ranges::move(part, std::back_inserter(rules));
+        }
+        std::ranges::sort(rules, {}, &Mined::lhs);
+        RuleDatabase result;
+        for (const auto& rule : rules) {
+            result.records.push_back({.offset = std::uint32_t(result.symbols.size()),
+                                      .lhs_size = std::uint8_t(rule.lhs.size()),
+                                      .rhs_size = std::uint8_t(rule.rhs.gens.size()),
+                                      .left_perm = std::uint16_t(rule.rhs.left_perm.vec().uint()),
+                                      .left_sym = rule.rhs.left_sym.data,
+                                      .right_perm = std::uint16_t(rule.rhs.right_perm.vec().uint())});
+            result.symbols.insert(result.symbols.end(), rule.lhs.begin(), rule.lhs.end());
+            for (auto gen : rule.rhs.gens) {
+                result.symbols.push_back(std::byte(gen.index()));
+            }
+        }
+        return result;
+    }
+
+    [[nodiscard]] inline std::size_t size() const noexcept { return records.size(); }
+    [[nodiscard]] inline std::vector<circ::CliffordGen<N>> lhs(std::size_t i) const noexcept {
+        return bytes(records[i]) | vw::transform([this](auto b) { return all_gen[std::size_t(b)]; }) | rgs::to<std::vector>();
+    }
+    [[nodiscard]] inline Synthesis<N> rhs(std::size_t i) const noexcept {
+        const auto& record = records[i];
+        Synthesis<N> result;
+        result.left_perm = circ::CircPerm(Bv<15>(record.left_perm));
+        result.left_sym = circ::Symmetry3N<N>(record.left_sym);
+        result.right_perm = circ::CircPerm(Bv<15>(record.right_perm));
+        for (auto b : std::span(symbols).subspan(record.offset + record.lhs_size, record.rhs_size)) {
+            result.gens.push_back(all_gen[std::size_t(b)]);
+        }
+        return result;
+    }
+
+    // The rule whose left-hand side is exactly `lhs`.
+    [[nodiscard]] inline std::optional<std::size_t> find(std::span<const circ::CliffordGen<N>> lhs) const noexcept {
+        auto key = lhs | vw::transform([](auto gen) { return std::byte(gen.index()); }) | rgs::to<std::vector>();
+        auto less = [](std::span<const std::byte> a, std::span<const std::byte> b) { return std::ranges::lexicographical_compare(a, b); };
+        auto it = std::ranges::lower_bound(records, std::span<const std::byte>(key), less, [this](const Record& r) { return bytes(r); });
+        if (it == records.end() || !std::ranges::equal(bytes(*it), key)) { return std::nullopt; }
+        return std::size_t(it - records.begin());
+    }
+
+    template <typename Archive>
+    void serialize(Archive& archive) {
+        archive(symbols, records);
+    }
+
+   private:
+    [[nodiscard]] inline std::span<const std::byte> bytes(const Record& record) const noexcept {
+        return std::span(symbols).subspan(record.offset, record.lhs_size);
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(rule_database) {
+    auto all_gen = circ::CliffordGen<3>::all_generator();
+    for (auto i = 0ul; i < all_gen.size(); i++) {
+        CHECK_EQ(all_gen[i].index(), i);
+    }
+
+    auto table = clfd::search::SynthesisTable<3>::build(clfd::search::search<3>());
+    auto rules = clfd::search::RuleDatabase<3>::mine(table, true, 4);
+    auto reducing = clfd::search::RuleDatabase<3>::mine(table, false, 1);
+    CHECK(rules.size() > reducing.size());
+    CHECK(reducing.size() > 0);
+    CHECK_THROWS(clfd::search::RuleDatabase<3>::mine(clfd::search::SynthesisTable<3>::build(clfd::search::search_depth<3>(false, 1))));
+
+    auto product = [](const std::vector<circ::CliffordGen<3>>& gens) {
+        auto result = clfd::BitSymplectic<3>::identity();
+        for (auto gen : gens) {
+            result = gen * result;
+        }
+        return result;
+    };
+    for (auto i = 0ul; i < rules.size(); i++) {
+        auto lhs = rules.lhs(i);
+        auto rhs = rules.rhs(i);
+        CHECK_EQ(product(lhs), rhs.matrix());
+        CHECK(rhs.gens.size() <= lhs.size());
+        CHECK_EQ(rules.find(lhs), i);
+        if (i > 0) { CHECK(rules.lhs(i - 1) != lhs); }
+        auto suffix = std::vector(lhs.begin() + 1, lhs.end());
+        CHECK(table.synthesize(product(suffix))->gens.size() == suffix.size());
+    }
+    for (auto i = 0ul; i < reducing.size(); i++) {
+        auto lhs = reducing.lhs(i);
+        CHECK(reducing.rhs(i).gens.size() < lhs.size());
+        CHECK(rules.find(lhs).has_value());
+    }
+    CHECK(!rules.find(table.path(1, 0)).has_value());
+}
+// NOLINTEND
@@ -2,15 +2,24 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <set>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/gateset/coupling.hpp"
 #include "../circuit/tree/newcirc.hpp"
+#include "../circuit/tree/prefix.hpp"
 #include "../table/bsearch_vec.hpp"
 #include "../utils/list.hpp"
 #include "../utils/ranges.hpp"
 #include "./bitsymplectic.hpp"
 #include "./gate.hpp"
 #include "reduce/quick.hpp"
+#include "reduce/restricted.hpp"
 
 template <std::size_t N>
 using CliffordCirc = List<circ::CliffordGen<N>>;
@@ -23,34 +32,146 @@ struct Point {
     BitSymplectic<N> value;
 };
 
+// Budget for a partial search. A layer that would exceed any limit is dropped as a whole, so the returned tree only
+// holds complete layers; a full search always ends with an empty layer, a truncated one does not.
+struct SearchLimits {
+    std::size_t max_layers = std::numeric_limits<std::size_t>::max();
+    std::size_t max_classes = std::numeric_limits<std::size_t>::max();
+    std::size_t max_bytes = std::numeric_limits<std::size_t>::max();
+};
+
+// Number of shortest generator sequences; it saturates at the maximum, since sequences to the deepest classes of N = 5
+// overflow 64 bits.
+using PathCount = std::uint64_t;
+
+[[nodiscard]] inline constexpr PathCount add_paths(PathCount a, PathCount b) noexcept {
+    return a > std::numeric_limits<PathCount>::max() - b ? std::numeric_limits<PathCount>::max() : a + b;
+}
+
+// Frontier entry of a path-counting search, ordered by `matrix` alone so that the count rides along in the search's own
+// sorted frontier. `node` is the ordinal of the class's tree node in its layer, or `NO_NODE` while the class has only
+// been reached by a commuting order that the tree skips, or lies closer than the last two layers.
 template <std::size_t N>
-circ::tree::Tree search(bool verbose = false) {  // NOLINT
-    auto all_gen = circ::CliffordGen<N>::all_generator();
+struct CountedClass {
+    static constexpr std::uint32_t NO_NODE = std::numeric_limits<std::uint32_t>::max();
+
+    BitSymplectic<N> matrix;
+    PathCount paths = 0;
+    std::uint32_t node = NO_NODE;
+
+    [[nodiscard]] inline constexpr bool operator==(const CountedClass& other) const noexcept { return matrix == other.matrix; }
+    [[nodiscard]] inline constexpr auto operator<=>(const CountedClass& other) const noexcept { return matrix <=> other.matrix; }
+};
+
+// BFS over classes reachable with `all_gen`; tree bytes index into `all_gen`. `reduce` must be a canonical form that is
+// invariant under left local Cliffords, and `eqcount` the size of its class.
+//
+// With `Counted`, `paths` receives one count per tree node, accumulated along the BFS like `bfs::search_entirely`'s
+// `acc_f`: a class is expanded once, from its first tree node, and every generator counts, including the commuting
+// orders that the tree skips. Nodes whose class was already reached by a shorter path (the first two tree layers are not
+// deduplicated) get a count of 0.
+template <std::size_t N, bool Counted = false, typename ReduceF, typename EqcountF>
+circ::tree::Tree search_with(const std::vector<circ::CliffordGen<N>>& all_gen, ReduceF&& reduce, EqcountF&& eqcount, bool verbose,  // NOLINT
+                             SearchLimits limits, std::vector<std::vector<PathCount>>* paths = nullptr) {
+    using Entry = std::conditional_t<Counted, CountedClass<N>, BitSymplectic<N>>;
     auto tree = circ::tree::Tree::from(vw::ints(0ul, all_gen.size()));
-    auto last2_layer = std::vector<BitSymplectic<N>>();
-    auto last_layer = std::vector<BitSymplectic<N>>();
+    auto tree_classes = all_gen.size();
+    auto tree_bytes = tree.layers.front().size();
+    auto last2_layer = std::vector<Entry>();
+    auto last_layer = std::vector<Entry>();
     auto symplectic_count = 0ul;
     auto percentage = 0ul;
     auto symplectic_count_total = symplectic_matrix_count(N);
 
+    // The first layer is not deduplicated, so while it is the parent layer its classes and the root stand in for the two
+    // counted frontiers, and only the first node of each class passes its count on.
+    auto find = [](std::vector<Entry>& layer, const BitSymplectic<N>& matrix) -> Entry* {
+        auto it = std::lower_bound(layer.begin(), layer.end(), Entry{matrix});
+        return it != layer.end() && *it == Entry{matrix} ? &*it : nullptr;
+    };
+    auto first_layer = std::vector<Entry>();
+    auto root = std::vector<Entry>();
+    auto first_of_class = std::vector<bool>();
+    auto* counted_last = &first_layer;
+    auto* counted_last2 = &root;
+    if constexpr (Counted) {
+        root.push_back({reduce(BitSymplectic<N>::identity()), 1});
+        for (auto gen : all_gen) {
+            auto reduced = reduce(gen * BitSymplectic<N>::identity());
+            auto* entry = find(first_layer, reduced);
+            first_of_class.push_back(entry == nullptr);
+            if (find(root, reduced) != nullptr) { continue; }
+            if (entry == nullptr) {
+                entry = &*first_layer.insert(std::upper_bound(first_layer.begin(), first_layer.end(), Entry{reduced}), {reduced});
+            }
+            entry->paths = add_paths(entry->paths, 1);
+        }
+        paths->push_back(all_gen | vw::transform([&](auto gen) {
+                             auto* entry = find(first_layer, reduce(gen * BitSymplectic<N>::identity()));
+                             return entry == nullptr ? PathCount(0) : entry->paths;
+                         }) |
+                         rgs::to<std::vector>());
+    }
+
     for (auto size = 2;; size++) {
-        table::BSearchVec<clfd::BitSymplectic<N>> bsvec;
+        table::BSearchVec<Entry> bsvec;
         circ::tree::GroupedSpanBuilder builder;
+        auto within_limits = [&] {
+            auto frontier_bytes = (last2_layer.size() + last_layer.size() + bsvec.size()) * sizeof(Entry);
+            return tree_classes + bsvec.size() <= limits.max_classes && tree_bytes + builder.size() + frontier_bytes <= limits.max_bytes;
+        };
+        if (tree.nlayers() >= limits.max_layers) { break; }
 
-        for (auto node : tree) {
+        auto step = [&all_gen](const BitSymplectic<N>& matrix, std::byte g) { return all_gen[std::size_t(g)] * matrix; };
+        auto nodes = std::uint32_t(0);
+        for (auto it = circ::tree::PrefixIter(tree.begin(), BitSymplectic<N>::identity(), step); it; ++it) {
+            if (!within_limits()) { break; }
             builder.new_span();
-            auto result = BitSymplectic<N>::identity();
-            for (auto g : node) {
-                result = all_gen[std::size_t(*g)] * result;
+            auto result = it.value();
+            auto parent = PathCount(0);
+            if constexpr (Counted) {
+                if (size > 2 || first_of_class[std::size_t(it.node()[0])]) {
+                    const auto* entry = find(*counted_last, reduce(result));
+                    parent = entry == nullptr ? 0 : entry->paths;
+                }
             }
+            // Of two commuting generators only the ascending order is expanded; the other order gives the same matrix.
+            auto last = std::size_t(it.node()[it.node().nlayers() - 1]);
             for (auto g : vw::ints(0ul, all_gen.size())) {
-                auto reduced_result = quick_reduce(all_gen[g] * result);
-                if (std::binary_search(last_layer.begin(), last_layer.end(), reduced_result)) { continue; }
-                if (std::binary_search(last2_layer.begin(), last2_layer.end(), reduced_result)) { continue; }
-                if (bsvec.contains(reduced_result)) { continue; }
-                builder.add(std::byte(g));
-                bsvec.insert(reduced_result);
-                symplectic_count += quick_reduce_eqcount(reduced_result);
+                auto pruned = g < last && all_gen[g].disjoint(all_gen[last]);
+                if (pruned && parent == 0) { continue; }
+                auto reduced_result = reduce(all_gen[g] * result);
+                if constexpr (Counted) {
+                    auto counted = [&](std::vector<Entry>* layer) {
+                        const auto* entry = find(*layer, reduced_result);
+                        return entry != nullptr && entry->paths > 0;
+                    };
+                    auto is_node = [&](std::vector<Entry>& layer) {
+                        const auto* entry = find(layer, reduced_result);
+                        return entry != nullptr && entry->node != Entry::NO_NODE;
+                    };
+                    auto counts = parent > 0 && !counted(counted_last) && !counted(counted_last2);
+                    auto adds = !pruned && !is_node(last_layer) && !is_node(last2_layer);
+                    if (!counts && !adds) { continue; }
+                    auto* entry = bsvec.find(Entry{reduced_result});
+                    if (entry == nullptr) {
+                        bsvec.insert({reduced_result, counts ? parent : 0, adds ? nodes : Entry::NO_NODE});
+                    } else {
+                        if (counts) { entry->paths = add_paths(entry->paths, parent); }
+                        adds = adds && entry->node == Entry::NO_NODE;
+                        if (adds) { entry->node = nodes; }
+                    }
+                    if (!adds) { continue; }
+                } else {
+                    if (pruned) { continue; }
+                    if (std::binary_search(last_layer.begin(), last_layer.end(), reduced_result)) { continue; }
+                    if (std::binary_search(last2_layer.begin(), last2_layer.end(), reduced_result)) { continue; }
+                    if (bsvec.contains(reduced_result)) { continue; }
+                    bsvec.insert(reduced_result);
+                }
+                builder.add(circ::tree::node_byte(g));
+                nodes++;
+                symplectic_count += eqcount(reduced_result);
                 auto p = symplectic_count * 100 / symplectic_count_total;
                 if (p != percentage && verbose) {
                     percentage = p;
@@ -59,14 +180,160 @@ circ::tree::Tree search(bool verbose = false) {  // NOLINT
             }
         }
 
+        if (!within_limits()) {
+            if (verbose) { fmt::println("Searching Symplectic<{}>: limit reached, dropping layer {}", N, size); }
+            break;
+        }
+
+        tree_classes += nodes;
+        tree_bytes += builder.size();
         last2_layer = std::move(last_layer);
         last_layer = std::move(bsvec.build_sorted());
         tree.add_layer(std::move(builder.build()));
+        if constexpr (Counted) {
+            auto& counts = paths->emplace_back(nodes, 0);
+            for (const auto& entry : last_layer) {
+                if (entry.node != Entry::NO_NODE) { counts[entry.node] = entry.paths; }
+            }
+            counted_last2 = counted_last == &first_layer ? &first_layer : &last2_layer;
+            counted_last = &last_layer;
+        }
 
-        if (last_layer.size() == 0) { break; }
+        if (nodes == 0) { break; }
     }
 
     return std::move(tree);
 }
 
-}  // namespace clfd::search
\ No newline at end of file
+template <std::size_t N>
+circ::tree::Tree search(bool verbose = false, SearchLimits limits = {}) {  // NOLINT
+    return search_with<N>(
+        circ::CliffordGen<N>::all_generator(), [](auto m) { return quick_reduce(m); }, [](auto m) { return quick_reduce_eqcount(m); }, verbose,
+        limits);
+}
+
+// Tree with `paths[l][k]`, the number of shortest generator sequences reaching the class of the k-th node of layer l.
+struct CountedTree {
+    circ::tree::Tree tree;
+    std::vector<std::vector<PathCount>> paths;
+
+    template <class Archive>
+    void serialize(Archive& ar) {
+        ar(tree, paths);
+    }
+};
+
+template <std::size_t N>
+CountedTree search_paths(bool verbose = false, SearchLimits limits = {}) {  // NOLINT
+    CountedTree result;
+    result.tree = search_with<N, true>(
+        circ::CliffordGen<N>::all_generator(), [](auto m) { return quick_reduce(m); }, [](auto m) { return quick_reduce_eqcount(m); }, verbose,
+        limits, &result.paths);
+    return result;
+}
+
+// Search restricted to the edges of `graph`. Classes are only quotiented by the graph automorphisms, so tree bytes index
+// into `graph.generators()`. The graph must be connected for the search to reach every symplectic matrix.
+template <std::size_t N>
+circ::tree::Tree search(const circ::CouplingGraph<N>& graph, bool verbose = false, SearchLimits limits = {}) {  // NOLINT
+    if (graph == circ::CouplingGraph<N>::complete()) { return search<N>(verbose, limits); }
+    auto group = qubit_perms<N>([&graph](auto&& perm) { return graph.is_automorphism(perm); });
+    return search_with<N>(
+        graph.generators(), [&group](auto m) { return restricted_reduce(m, group); },
+        [&group](auto m) { return restricted_reduce_eqcount(m, group); }, verbose, limits);
+}
+
+}  // namespace clfd::search
+// NOLINTBEGIN
+TEST_FN(search_limits) {
+    auto full = clfd::search::search<3>();
+    auto partial = clfd::search::search<3>(false, {.max_layers = 2});
+    CHECK_EQ(partial.nlayers(), 2);
+    CHECK_EQ(partial.layers[1], full.layers[1]);
+
+    auto bounded = clfd::search::search<3>(false, {.max_classes = 100});
+    CHECK_EQ(bounded.nlayers(), 1);
+    CHECK_EQ(rgs::distance(bounded.begin(), bounded.end()), 54);
+}
+
+TEST_FN(search_commutation_pruning) {
+    auto tree = clfd::search::search<4>(false, {.max_layers = 4});
+    auto sizes = tree.layers | vw::transform([](auto&& layer) { return circ::tree::GroupedSpan::from(layer).count(); }) | rgs::to<std::vector>();
+    CHECK_EQ(sizes, std::vector<std::size_t>{1, 108, 100, 1741});
+    CHECK_EQ(rgs::distance(tree.begin(), tree.end()), 18369);
+}
+
+TEST_FN(search_coupling) {
+    auto automorphisms = []<std::size_t N>(const circ::CouplingGraph<N>& graph) {
+        return clfd::qubit_perms<N>([&graph](auto&& perm) { return graph.is_automorphism(perm); });
+    };
+    auto tee = circ::CouplingGraph<4>::from({{0, 1}, {1, 2}, {1, 3}});
+    CHECK_EQ(tee.generators().size(), 54);
+    CHECK_EQ(automorphisms(tee).size(), 6);
+    CHECK_EQ(automorphisms(circ::CouplingGraph<5>::ring()).size(), 10);
+
+    auto line = circ::CouplingGraph<3>::line();
+    auto group = automorphisms(line);
+    CHECK_EQ(group.size(), 2);
+    auto all_gen = line.generators();
+    auto tree = clfd::search::search(line);
+    // The first two layers are not deduplicated against shorter paths, so classes are collected first.
+    auto classes = std::set<clfd::BitSymplectic<3>>{clfd::restricted_reduce(clfd::BitSymplectic<3>::identity(), group)};
+    for (auto nlayers : vw::ints(1ul, tree.nlayers() + 1)) {
+        for (auto node : circ::tree::Tree::Iter(tree, nlayers)) {
+            auto result = clfd::BitSymplectic<3>::identity();
+            for (auto g : node) {
+                result = all_gen[std::size_t(*g)] * result;
+            }
+            CHECK(rgs::all_of(node, [&all_gen](auto g) { return all_gen[std::size_t(*g)].ictrl() + all_gen[std::size_t(*g)].inot() != 2; }));
+            classes.insert(clfd::restricted_reduce(result, group));
+        }
+    }
+    auto total = rgs::accumulate(classes | vw::transform([&group](auto m) { return clfd::restricted_reduce_eqcount(m, group); }), 0ul);
+    CHECK_EQ(total, clfd::symplectic_matrix_count(3));
+    CHECK_EQ(clfd::search::search(circ::CouplingGraph<3>::ring()).layers, clfd::search::search<3>().layers);
+}
+TEST_FN(search_paths) {
+    auto all_gen = circ::CliffordGen<3>::all_generator();
+    auto counted = clfd::search::search_paths<3>();
+    CHECK_EQ(counted.tree.layers, clfd::search::search<3>().layers);
+    CHECK_EQ(counted.paths.size(), counted.tree.nlayers());
+
+    auto distance = std::map<clfd::BitSymplectic<3>, std::size_t>{{clfd::quick_reduce(clfd::BitSymplectic<3>::identity()), 0}};
+    auto paths = std::map<clfd::BitSymplectic<3>, std::uint64_t>();
+    for (auto nlayers : vw::ints(1ul, 4ul)) {
+        auto index = 0ul;
+        for (auto node : circ::tree::Tree::Iter(counted.tree, nlayers)) {
+            auto result = clfd::BitSymplectic<3>::identity();
+            for (auto g : node) {
+                result = all_gen[std::size_t(*g)] * result;
+            }
+            auto count = counted.paths[nlayers - 1][index++];
+            if (count == 0) { continue; }
+            distance.emplace(clfd::quick_reduce(result), nlayers);
+            paths.emplace(clfd::quick_reduce(result), count);
+        }
+        CHECK_EQ(index, counted.paths[nlayers - 1].size());
+    }
+
+    auto brute = std::map<clfd::BitSymplectic<3>, std::uint64_t>();
+    auto visit = [&](auto&& self, clfd::BitSymplectic<3> result, std::size_t length) -> void {
+        if (length > 0) {
+            auto it = distance.find(clfd::quick_reduce(result));
+            if (it == distance.end() || it->second != length) { return; }
+            brute[it->first] += 1;
+        }
+        if (length == 3) { return; }
+        for (auto gen : all_gen) {
+            self(self, gen * result, length + 1);
+        }
+    };
+    visit(visit, clfd::BitSymplectic<3>::identity(), 0);
+    CHECK_EQ(brute.size(), 6 + 72 + 136);
+    CHECK(brute == paths);
+
+    auto max = std::numeric_limits<clfd::search::PathCount>::max();
+    CHECK_EQ(clfd::search::add_paths(max - 1, 1), max);
+    CHECK_EQ(clfd::search::add_paths(max - 1, 2), max);
+}
+// NOLINTEND
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <experimental/random>
+#include <type_traits>
+#include <variant>
+#include "../circuit/gateset/gate/gate.hpp"
+#include "../utils/bitvec.hpp"
+#include "./bitsymplectic.hpp"
+
+namespace clfd {
+
+// A Clifford up to global phase: the symplectic matrix and the sign of each column's image, so that Pauli gates are no
+// longer the identity. Sign updates work on whole rows, one bit per column.
+template <std::size_t N>
+struct SignedSymplectic {
+    BitSymplectic<N> matrix = BitSymplectic<N>::identity();
+    Bv<2 * N> signs = Bv<2 * N>::zero();
+
+    [[nodiscard]] inline bool operator==(const SignedSymplectic&) const noexcept = default;
+
+    inline void do_x(std::size_t q) noexcept { signs ^= matrix.zrow(q); }
+    inline void do_z(std::size_t q) noexcept { signs ^= matrix.xrow(q); }
+    inline void do_hadamard(std::size_t q) noexcept {
+        signs ^= matrix.xrow(q) & matrix.zrow(q);
+        matrix.do_hadamard_l(q);
+    }
+    inline void do_phase(std::size_t q) noexcept {
+        signs ^= matrix.xrow(q) & matrix.zrow(q);
+        matrix.do_phase_l(q);
+    }
+    inline void do_cnot(std::size_t ctrl, std::size_t target) noexcept {
+        signs ^= matrix.xrow(ctrl) & matrix.zrow(target) & ~(matrix.xrow(target) ^ matrix.zrow(ctrl));
+        matrix.do_cnot_l(ctrl, target);
+    }
+
+    // Clifford gates of `circ::gate` on qubits below N.
+    inline void do_mul_l(const circ::gate::Gate& gate) noexcept {
+        using namespace circ::gate;
+        if (const auto* g1 = std::get_if<Gate1>(&gate)) {
+            auto q = g1->qubits[0];
+            std::visit(
+                [&]<typename G>(const G&) {
+                    if constexpr (std::is_same_v<G, Gate1::X>) {
+                        do_x(q);
+                    } else if constexpr (std::is_same_v<G, Gate1::Y>) {
+                        do_x(q);
+                        do_z(q);
+                    } else if constexpr (std::is_same_v<G, Gate1::Z>) {
+                        do_z(q);
+                    } else if constexpr (std::is_same_v<G, Gate1::H>) {
+                        do_hadamard(q);
+                    } else if constexpr (std::is_same_v<G, Gate1::S>) {
+                        do_phase(q);
+                    } else if constexpr (std::is_same_v<G, Gate1::SDG>) {
+                        do_phase(q);
+                        do_z(q);
+                    } else if constexpr (std::is_same_v<G, Gate1::SRN>) {
+                        do_hadamard(q);
+                        do_phase(q);
+                        do_hadamard(q);
+                    } else {
+                        assert(false && "not a Clifford gate");
+                    }
+                },
+                g1->gate);
+        } else if (const auto* g2 = std::get_if<Gate2>(&gate)) {
+            auto [a, b] = g2->qubits;
+            std::visit(
+                [&]<typename G>(const G&) {
+                    if constexpr (std::is_same_v<G, Gate2::CX>) {
+                        do_cnot(a, b);
+                    } else if constexpr (std::is_same_v<G, Gate2::CZ>) {
+                        do_hadamard(b);
+                        do_cnot(a, b);
+                        do_hadamard(b);
+                    } else if constexpr (std::is_same_v<G, Gate2::CY>) {
+                        do_phase(b);
+                        do_z(b);
+                        do_cnot(a, b);
+                        do_phase(b);
+                    } else if constexpr (std::is_same_v<G, Gate2::SWAP>) {
+                        matrix.do_swap_l(a, b);
+                    } else {
+                        assert(false && "not a Clifford gate");
+                    }
+                },
+                g2->gate);
+        }
+    }
+
+    // Qubit `q` becomes qubit `perm[q]`; signs do not change.
+    template <typename Perm>
+    inline void do_permute_l(const Perm& perm) noexcept {
+        std::array<Bv<2 * N>, 2 * N> rows;
+        for (auto q = 0ul; q < N; q++) {
+            rows[perm[q]] = matrix.xrow(q);
+            rows[perm[q] + N] = matrix.zrow(q);
+        }
+        matrix = BitSymplectic<N>::from_array(rows);
+    }
+
+    // The Pauli P, x bits then z bits, such that applying it last turns `signs` into `target`. P anticommutes with
+    // column c iff ⟨M⁻¹ P, e_c⟩ = 1, so M⁻¹ P is read off the sign difference and mapped back through M.
+    [[nodiscard]] inline Bv<2 * N> pauli_correction(Bv<2 * N> target) const noexcept {
+        auto diff = target ^ signs;
+        auto preimage = (diff >> N) | ((diff << N) & (Bv<2 * N>::ones() << N));
+        auto result = Bv<2 * N>::zero();
+        for (auto q = 0ul; q < N; q++) {
+            result = result.update(q, matrix.xrow(q).dot(preimage)).update(q + N, matrix.zrow(q).dot(preimage));
+        }
+        return result;
+    }
+};
+
+}  // namespace clfd
+
+// NOLINTBEGIN
+TEST_FN(signed_symplectic) {
+    using namespace circ::gate;
+    auto hzh = clfd::SignedSymplectic<2>();
+    hzh.do_mul_l(Gate1::H{}(0));
+    hzh.do_mul_l(Gate1::Z{}(0));
+    hzh.do_mul_l(Gate1::H{}(0));
+    auto x = clfd::SignedSymplectic<2>();
+    x.do_mul_l(Gate1::X{}(0));
+    CHECK_EQ(hzh, x);
+
+    auto ss = clfd::SignedSymplectic<2>();
+    ss.do_mul_l(Gate1::S{}(1));
+    ss.do_mul_l(Gate1::S{}(1));
+    auto z = clfd::SignedSymplectic<2>();
+    z.do_mul_l(Gate1::Z{}(1));
+    CHECK_EQ(ss, z);
+    ss.do_mul_l(Gate1::SDG{}(1));
+    ss.do_mul_l(Gate1::SDG{}(1));
+    CHECK_EQ(ss, clfd::SignedSymplectic<2>());
+
+    // CX (X ⊗ X) CX = X ⊗ I, and CZ = H CX H on the target.
+    auto cx = clfd::SignedSymplectic<2>();
+    cx.do_mul_l(Gate2(Gate2::CX{}, 0, 1));
+    cx.do_mul_l(Gate1::X{}(0));
+    cx.do_mul_l(Gate1::X{}(1));
+    cx.do_mul_l(Gate2(Gate2::CX{}, 0, 1));
+    CHECK_EQ(cx, x);
+    auto cy = clfd::SignedSymplectic<2>();
+    cy.do_mul_l(Gate2(Gate2::CY{}, 0, 1));
+    cy.do_mul_l(Gate2(Gate2::CY{}, 0, 1));
+    CHECK_EQ(cy, clfd::SignedSymplectic<2>());
+
+    for (auto i = 0ul; i < 100ul; i++) {
+        auto target = clfd::SignedSymplectic<3>();
+        for (auto j = 0ul; j < 30ul; j++) {
+            auto a = QIdx(std::experimental::randint(0, 2));
+            auto b = QIdx((a + std::experimental::randint(1, 2)) % 3);
+            std::array<Gate, 6> gates{Gate1::H{}(a), Gate1::S{}(a), Gate1::X{}(a), Gate1::Y{}(a), Gate2(Gate2::CX{}, a, b), Gate2(Gate2::CZ{}, a, b)};
+            target.do_mul_l(gates[std::experimental::randint(0ul, gates.size() - 1)]);
+        }
+        auto corrected = clfd::SignedSymplectic<3>{target.matrix, Bv<6>::zero()};
+        auto pauli = corrected.pauli_correction(target.signs);
+        for (auto q = 0ul; q < 3; q++) {
+            if (pauli[q]) { corrected.do_x(q); }
+            if (pauli[q + 3]) { corrected.do_z(q); }
+        }
+        CHECK_EQ(corrected, target);
+    }
+}
+// NOLINTEND
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "../circuit/gateset/gate/gate.hpp"
+#include "../circuit/gateset/symmetry3.hpp"
+#include "../utils/bitvec.hpp"
+#include "../utils/fmt.hpp"
+#include "./bitsymplectic.hpp"
+#include "./count.hpp"
+#include "./gate.hpp"
+#include "./search.hpp"
+#include "./synthesis.hpp"
+#include "cereal/archives/binary.hpp"
+#include "cereal/cereal.hpp"
+#include "cereal/types/vector.hpp"
+
+namespace clfd {
+
+// A stabilizer state up to Pauli signs: the span of the images of Z_0 … Z_{N-1}, which are the Z columns of any
+// Clifford preparing it from |0…0⟩. The basis is kept in reduced row echelon form, so equal groups compare equal no
+// matter which Clifford they came from.
+template <std::size_t N>
+class StabilizerState {
+    static_assert(N <= 7ul);
+    std::array<Bv<2 * N>, N> basis;
+
+   public:
+    // `vectors` must be independent and commute pairwise.
+    inline explicit constexpr StabilizerState(const std::array<Bv<2 * N>, N>& vectors) noexcept : basis(vectors) { echelon(); }
+
+    [[nodiscard]] inline constexpr auto operator<=>(const StabilizerState&) const noexcept = default;
+
+    [[nodiscard]] inline constexpr static StabilizerState zero() noexcept {
+        std::array<Bv<2 * N>, N> vectors;
+        for (auto j = 0ul; j < N; j++) {
+            vectors[j] = Bv<2 * N>::zero().update(j + N, true);
+        }
+        return StabilizerState(vectors);
+    }
+    [[nodiscard]] inline constexpr static StabilizerState from(const BitSymplectic<N>& matrix) noexcept {
+        std::array<Bv<2 * N>, N> vectors;
+        for (auto j = 0ul; j < N; j++) {
+            vectors[j] = matrix.zcol(j);
+        }
+        return StabilizerState(vectors);
+    }
+
+    // `vectors` as a state, or nothing unless they are independent and commute pairwise.
+    [[nodiscard]] inline constexpr static std::optional<StabilizerState> from_generators(std::array<Bv<2 * N>, N> vectors) noexcept {
+        auto x = [](Bv<2 * N> v) { return Bv<N>::slice(v, 0); };
+        auto z = [](Bv<2 * N> v) { return Bv<N>::slice(v, N); };
+        for (auto i = 0ul; i < N; i++) {
+            for (auto j = i + 1; j < N; j++) {
+                if (((x(vectors[i]) & z(vectors[j])) ^ (z(vectors[i]) & x(vectors[j]))).count_ones() % 2 != 0) { return std::nullopt; }
+            }
+        }
+        auto rank = 0ul;
+        for (auto bit = 0ul; bit < 2 * N && rank < N; bit++) {
+            auto pivot = std::find_if(vectors.begin() + std::ptrdiff_t(rank), vectors.end(), [bit](auto v) { return v[bit]; });
+            if (pivot == vectors.end()) { continue; }
+            std::swap(*pivot, vectors[rank]);
+            for (auto i = rank + 1; i < N; i++) {
+                if (vectors[i][bit]) { vectors[i] ^= vectors[rank]; }
+            }
+            rank++;
+        }
+        if (rank < N) { return std::nullopt; }
+        return StabilizerState(vectors);
+    }
+
+    [[nodiscard]] inline constexpr const std::array<Bv<2 * N>, N>& vectors() const noexcept { return basis; }
+
+    // The same row operations as `BitSymplectic::do_*_l`, on every stabilizer.
+    inline constexpr void do_hadamard(std::size_t q) noexcept {
+        for (auto& v : basis) {
+            auto x = v[q];
+            v = v.update(q, v[q + N]).update(q + N, x);
+        }
+        echelon();
+    }
+    inline constexpr void do_phase(std::size_t q) noexcept {
+        for (auto& v : basis) {
+            v = v.xor_at(q + N, v[q]);
+        }
+        echelon();
+    }
+    inline constexpr void do_cnot(std::size_t ctrl, std::size_t target) noexcept {
+        for (auto& v : basis) {
+            v = v.xor_at(target, v[ctrl]).xor_at(ctrl + N, v[target + N]);
+        }
+        echelon();
+    }
+
+    // H, S, H by the bits of `op`, as `do_symplectic_multiply_l`.
+    inline constexpr void do_local(std::size_t q, circ::Symmetry3 op) noexcept {
+        if (op.bv()[0]) { do_hadamard(q); }
+        if (op.bv()[1]) { do_phase(q); }
+        if (op.bv()[2]) { do_hadamard(q); }
+    }
+
+    // Qubit `q` becomes qubit `perm[q]`.
+    [[nodiscard]] inline constexpr StabilizerState permuted(const std::array<QIdx, N>& perm) const noexcept {
+        std::array<Bv<2 * N>, N> vectors;
+        for (auto i = 0ul; i < N; i++) {
+            auto v = Bv<2 * N>::zero();
+            for (auto q = 0ul; q < N; q++) {
+                v = v.update(perm[q], basis[i][q]).update(perm[q] + N, basis[i][q + N]);
+            }
+            vectors[i] = v;
+        }
+        return StabilizerState(vectors);
+    }
+
+    [[nodiscard]] inline std::string fmt() const noexcept { return fmt::format("State[{}]", fmt::join(basis, " ")); }
+
+   private:
+    // Pivots on the highest bit; rows in decreasing order with every pivot column cleared elsewhere.
+    inline constexpr void echelon() noexcept {
+        auto rank = 0ul;
+        for (auto bit = 2 * N; bit-- > 0 && rank < N;) {
+            auto pivot = std::find_if(basis.begin() + std::ptrdiff_t(rank), basis.end(), [bit](auto v) { return v[bit]; });
+            if (pivot == basis.end()) { continue; }
+            std::swap(*pivot, basis[rank]);
+            for (auto i = 0ul; i < N; i++) {
+                if (i != rank && basis[i][bit]) { basis[i] ^= basis[rank]; }
+            }
+            rank++;
+        }
+        assert(rank == N);
+    }
+};
+
+template <std::size_t N>
+auto format_as(const StabilizerState<N>& state) {
+    return state.fmt();
+}
+
+}  // namespace clfd
+
+template <std::size_t N>
+struct std::hash<clfd::StabilizerState<N>> {  // NOLINT
+    std::size_t operator()(const clfd::StabilizerState<N>& state) const noexcept {
+        std::size_t h = 0;
+        for (auto v : state.vectors()) {
+            h = h * 0x9e3779b97f4a7c15ul + std::hash<uint64_t>{}(v.uint());
+        }
+        return h;
+    }
+};
+
+namespace clfd::search {
+
+// One step of a state preparation. Single-qubit gates are free; only CX is counted.
+struct StateMove {
+    enum class Kind : std::uint8_t { H, S, CX };
+    Kind kind;
+    QIdx a;
+    QIdx b = 0;
+
+    [[nodiscard]] inline constexpr std::size_t cost() const noexcept { return kind == Kind::CX ? 1 : 0; }
+    template <std::size_t N>
+    inline constexpr void apply(StabilizerState<N>& state) const noexcept {
+        switch (kind) {
+            case Kind::H: state.do_hadamard(a); break;
+            case Kind::S: state.do_phase(a); break;
+            case Kind::CX: state.do_cnot(a, b); break;
+        }
+    }
+    [[nodiscard]] inline circ::gate::Gate gate() const noexcept {
+        using namespace circ::gate;
+        switch (kind) {
+            case Kind::H: return Gate1::H{}(a);
+            case Kind::S: return Gate1::S{}(a);
+            case Kind::CX: return Gate2(Gate2::CX{}, a, b);
+        }
+        __builtin_unreachable();
+    }
+};
+
+// The least state of the relabeling orbit, the relabeling reaching it and the orbit size.
+template <std::size_t N>
+struct CanonicalState {
+    StabilizerState<N> state;
+    std::array<QIdx, N> perm;
+    std::size_t orbit;
+};
+
+template <std::size_t N>
+[[nodiscard]] inline CanonicalState<N> canonical_state(const StabilizerState<N>& state) noexcept {
+    std::array<QIdx, N> perm;
+    std::iota(perm.begin(), perm.end(), QIdx(0));
+    auto result = CanonicalState<N>{state, perm, 0};
+    auto automorphisms = 0ul;
+    auto total = 0ul;
+    do {
+        auto permuted = state.permuted(perm);
+        if (permuted < result.state) {
+            result.state = permuted;
+            result.perm = perm;
+            automorphisms = 0;
+        }
+        automorphisms += permuted == result.state ? 1 : 0;
+        total++;
+    } while (std::next_permutation(perm.begin(), perm.end()));
+    result.orbit = total / automorphisms;
+    return result;
+}
+
+// Optimal CX counts for preparing every stabilizer state from |0…0⟩, with single-qubit gates free. States are
+// identified up to qubit relabeling and searched by 0-1 BFS: H and S move within a layer, CX moves to the next.
+// Compared with `search<N>`, which enumerates unitaries, the state space is smaller by roughly the size of the
+// stabilizer of |0…0⟩, so the same approach reaches a few more qubits.
+template <std::size_t N>
+class StatePrepTable {
+    struct Entry {
+        StabilizerState<N> state = StabilizerState<N>::zero();   // canonical
+        std::size_t distance = 0;
+        StabilizerState<N> parent = StabilizerState<N>::zero();  // canonical
+        StateMove move = {StateMove::Kind::H, 0};                // in the qubits of `parent`
+        std::array<QIdx, N> perm{};                              // turns `move(parent)` into `state`
+        std::size_t orbit = 0;
+
+        template <class Archive>
+        void serialize(Archive& archive) {
+            archive(cereal::binary_data(this, sizeof(Entry)));
+        }
+    };
+    static_assert(std::is_trivially_copyable_v<Entry>);
+    // Sorted by state, which is what gets saved.
+    std::vector<Entry> entries;
+
+    [[nodiscard]] inline const Entry* find(const StabilizerState<N>& state) const noexcept {
+        auto it = std::ranges::lower_bound(entries, state, {}, &Entry::state);
+        return it != entries.end() && it->state == state ? &*it : nullptr;
+    }
+
+   public:
+    [[nodiscard]] inline static StatePrepTable build(bool verbose = false) {
+        std::vector<StateMove> moves;
+        for (auto a = QIdx(0); a < N; a++) {
+            moves.push_back({StateMove::Kind::H, a});
+            moves.push_back({StateMove::Kind::S, a});
+            for (auto b = QIdx(0); b < N; b++) {
+                if (a != b) { moves.push_back({StateMove::Kind::CX, a, b}); }
+            }
+        }
+
+        std::unordered_map<StabilizerState<N>, Entry> reached;
+        auto root = canonical_state(StabilizerState<N>::zero());
+        reached.emplace(root.state, Entry{root.state, 0, root.state, {StateMove::Kind::H, 0}, root.perm, root.orbit});
+        std::deque<StabilizerState<N>> queue{root.state};
+        while (!queue.empty()) {
+            auto state = queue.front();
+            queue.pop_front();
+            auto distance = reached.at(state).distance;
+            for (auto move : moves) {
+                auto next = state;
+                move.apply(next);
+                auto canonical = canonical_state(next);
+                auto entry = Entry{canonical.state, distance + move.cost(), state, move, canonical.perm, canonical.orbit};
+                auto [it, inserted] = reached.try_emplace(canonical.state, entry);
+                if (!inserted && it->second.distance <= entry.distance) { continue; }
+                it->second = entry;
+                if (move.cost() == 0) {
+                    queue.push_front(canonical.state);
+                } else {
+                    queue.push_back(canonical.state);
+                }
+            }
+        }
+        StatePrepTable table;
+        table.entries.reserve(reached.size());
+        for (const auto& [state, entry] : reached) {
+            table.entries.push_back(entry);
+        }
+        std::ranges::sort(table.entries, {}, &Entry::state);
+        if (verbose) {
+            for (auto layer : table.layers()) {
+                fmt::println("Stabilizer states <{}>: distance {} classes {} elements {}", N, layer.distance, layer.classes, layer.elements);
+            }
+        }
+        return table;
+    }
+
+    [[nodiscard]] inline std::size_t size() const noexcept { return entries.size(); }
+
+    // Classes are relabeling orbits; elements count the states themselves.
+    [[nodiscard]] inline std::vector<LayerCount> layers() const {
+        std::vector<LayerCount> result;
+        for (const auto& entry : entries) {
+            while (result.size() <= entry.distance) {
+                result.push_back({result.size(), 0, 0});
+            }
+            result[entry.distance].classes += 1;
+            result[entry.distance].elements += entry.orbit;
+        }
+        return result;
+    }
+
+    [[nodiscard]] inline std::optional<std::size_t> distance(const StabilizerState<N>& target) const noexcept {
+        const auto* entry = find(canonical_state(target).state);
+        if (entry == nullptr) { return std::nullopt; }
+        return entry->distance;
+    }
+
+    // Gates preparing `target` from |0…0⟩, first applied first, with the fewest CX.
+    [[nodiscard]] inline std::optional<std::vector<StateMove>> prepare(const StabilizerState<N>& target) const {
+        auto canonical = canonical_state(target);
+        // `target` is the canonical state relabeled by `perm`.
+        std::array<QIdx, N> perm;
+        for (auto q = 0ul; q < N; q++) {
+            perm[canonical.perm[q]] = QIdx(q);
+        }
+        auto state = canonical.state;
+        std::vector<StateMove> result;
+        for (;;) {
+            const auto* found = find(state);
+            if (found == nullptr) { return std::nullopt; }
+            const auto& entry = *found;
+            if (entry.distance == 0 && entry.parent == state) { break; }
+            // `state == move(parent)` relabeled by `entry.perm`, so the step acts on `perm ∘ entry.perm`.
+            std::array<QIdx, N> next;
+            for (auto q = 0ul; q < N; q++) {
+                next[q] = perm[entry.perm[q]];
+            }
+            auto move = entry.move;
+            move.a = next[move.a];
+            move.b = next[move.b];
+            result.push_back(move);
+            perm = next;
+            state = entry.parent;
+        }
+        std::ranges::reverse(result);
+        return result;
+    }
+
+    template <class Archive>
+    void serialize(Archive& archive) {
+        archive(entries);
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(stabilizer_state) {
+    auto bell = clfd::StabilizerState<2>::zero();
+    bell.do_hadamard(0);
+    bell.do_cnot(0, 1);
+    auto matrix = clfd::BitSymplectic<2>::identity();
+    matrix.do_hadamard_l(0);
+    matrix.do_cnot_l(0, 1);
+    CHECK_EQ(bell, clfd::StabilizerState<2>::from(matrix));
+    CHECK_EQ(bell.permuted({1, 0}), bell);
+
+    // Unsigned stabilizer states number ∏ (2^k + 1).
+    auto table2 = clfd::search::StatePrepTable<2>::build();
+    auto layers2 = table2.layers();
+    CHECK_EQ(layers2.size(), 2);
+    CHECK_EQ(layers2[0].elements + layers2[1].elements, 3 * 5);
+    CHECK_EQ(table2.distance(bell), 1);
+
+    auto table = clfd::search::StatePrepTable<4>::build();
+    auto elements = 0ul;
+    for (auto layer : table.layers()) {
+        elements += layer.elements;
+    }
+    CHECK_EQ(elements, 3 * 5 * 9 * 17);
+
+    auto unitary = clfd::search::SynthesisTable<4>::build(clfd::search::search<4>(false, {.max_layers = 3}));
+    for (auto i = 0ul; i < 200ul; i++) {
+        auto target = clfd::BitSymplectic<4>::identity();
+        perform_random_gates(target, 30, clfd::CliffordGate<4>::all_gates(), Bv<2>(0b11));
+        auto state = clfd::StabilizerState<4>::from(target);
+        auto moves = table.prepare(state);
+        CHECK(moves.has_value());
+        auto prepared = clfd::StabilizerState<4>::zero();
+        auto cx = 0ul;
+        for (auto move : *moves) {
+            move.apply(prepared);
+            cx += move.cost();
+        }
+        CHECK_EQ(prepared, state);
+        CHECK_EQ(cx, table.distance(state));
+        if (auto synthesis = unitary.synthesize(target)) { CHECK(cx <= synthesis->gens.size()); }
+    }
+
+    // A saved table answers like the one that ran the search.
+    std::stringstream saved;
+    cereal::BinaryOutputArchive output(saved);
+    output(table);
+    clfd::search::StatePrepTable<4> loaded;
+    cereal::BinaryInputArchive input(saved);
+    input(loaded);
+    CHECK_EQ(loaded.size(), table.size());
+    for (auto i = 0ul; i < 100ul; i++) {
+        auto target = clfd::BitSymplectic<4>::identity();
+        perform_random_gates(target, 30, clfd::CliffordGate<4>::all_gates(), Bv<2>(0b11));
+        auto state = clfd::StabilizerState<4>::from(target);
+        CHECK_EQ(loaded.distance(state), table.distance(state));
+        CHECK(loaded.prepare(state).has_value());
+    }
+
+    auto zero = clfd::StabilizerState<2>::zero().vectors();
+    CHECK_EQ(clfd::StabilizerState<2>::from_generators(zero), clfd::StabilizerState<2>::zero());
+    CHECK(!clfd::StabilizerState<2>::from_generators({zero[0], zero[0]}).has_value());
+    CHECK(!clfd::StabilizerState<2>::from_generators({Bv<4>(0b0001), Bv<4>(0b0100)}).has_value());
+}
+// NOLINTEND
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/gateset/permutation.hpp"
+#include "../circuit/gateset/symmetry3.hpp"
+#include "../circuit/tree/mapped.hpp"
+#include "../circuit/tree/prefix.hpp"
+#include "../circuit/tree/succinct.hpp"
+#include "../circuit/tree/tree.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./depth.hpp"
+#include "./gate.hpp"
+#include "./search.hpp"
+#include "reduce/quick.hpp"
+
+namespace clfd::search {
+
+// An optimal circuit for a target: `target == left_perm * ((left_sym * product(gens)) * right_perm)`, where generators
+// are applied first to last.
+template <std::size_t N>
+struct Synthesis {
+    circ::CircPerm left_perm;
+    circ::Symmetry3N<N> left_sym;
+    std::vector<circ::CliffordGen<N>> gens;
+    circ::CircPerm right_perm;
+
+    [[nodiscard]] inline BitSymplectic<N> product() const noexcept {
+        auto result = BitSymplectic<N>::identity();
+        for (auto gen : gens) {
+            result = gen * result;
+        }
+        return result;
+    }
+    [[nodiscard]] inline BitSymplectic<N> matrix() const noexcept { return left_perm * ((left_sym * product()) * right_perm); }
+};
+
+template <std::size_t N>
+struct IndexEntry {
+    BitSymplectic<N> canonical = BitSymplectic<N>::null();
+    std::uint32_t layer = 0;
+    std::uint32_t ordinal = 0;
+
+    [[nodiscard]] inline constexpr auto operator<=>(const IndexEntry&) const noexcept = default;
+
+    template <class Archive>
+    void serialize(Archive& archive) {
+        archive(canonical, layer, ordinal);
+    }
+};
+
+// Lookup from `quick_reduce` canonical forms to the nodes of a `search<N>` tree. The sorted entries are what gets saved
+// next to the tree. The table keeps the tree, or the mapping of a saved one, and decodes paths through a
+// `SuccinctIndex` over its layers, so a mapped tree is never copied. Copies share the tree. A table over a `DepthTree`
+// indexes the nodes that end a step and decodes their paths with `DepthTree::decode`.
+template <std::size_t N>
+class SynthesisTable {
+    std::vector<circ::CliffordGen<N>> all_gen = circ::CliffordGen<N>::all_generator();
+    std::shared_ptr<const void> storage;
+    circ::tree::SuccinctIndex paths;
+    std::vector<IndexEntry<N>> entries;
+    bool steps = false;
+
+   public:
+    inline explicit SynthesisTable(circ::tree::Tree tree, std::vector<IndexEntry<N>> entries) : entries(std::move(entries)) {
+        assert(std::is_sorted(this->entries.begin(), this->entries.end()));
+        auto owned = std::make_shared<const circ::tree::Tree>(std::move(tree));
+        paths = circ::tree::SuccinctIndex::from(*owned);
+        storage = std::move(owned);
+    }
+    inline explicit SynthesisTable(DepthTree<N> tree, std::vector<IndexEntry<N>> entries)
+        : SynthesisTable(std::move(tree.tree), std::move(entries)) {
+        steps = true;
+    }
+    inline explicit SynthesisTable(circ::tree::MappedTree tree, std::vector<IndexEntry<N>> entries) : entries(std::move(entries)) {
+        assert(std::is_sorted(this->entries.begin(), this->entries.end()));
+        auto owned = std::make_shared<const circ::tree::MappedTree>(std::move(tree));
+        paths = circ::tree::SuccinctIndex::from(owned->layers());
+        storage = std::move(owned);
+    }
+
+    // Replays every node once, each layer split into contiguous ranges over `nthreads` workers. A class reached by
+    // several nodes keeps the shortest one.
+    [[nodiscard]] inline static SynthesisTable build(const circ::tree::Tree& tree, std::size_t nthreads = std::thread::hardware_concurrency()) {
+        auto all_gen = circ::CliffordGen<N>::all_generator();
+        auto index = circ::tree::SuccinctIndex::from(tree);
+        std::vector<IndexEntry<N>> entries{{quick_reduce(BitSymplectic<N>::identity()), std::uint32_t(-1), 0}};
+        for (auto layer : vw::ints(0ul, tree.nlayers())) {
+            auto base = entries.size();
+            entries.resize(base + index.layer_size(layer));
+            auto replay = [&](const circ::tree::TreePartition& part) {
+                auto step = [&all_gen](const BitSymplectic<N>& matrix, std::byte g) { return all_gen[std::size_t(g)] * matrix; };
+                auto it = circ::tree::PrefixIter(part.first, BitSymplectic<N>::identity(), step);
+                for (auto ordinal = part.offset; ordinal < part.offset + part.size; ordinal++, ++it) {
+                    entries[base + ordinal] = {quick_reduce(it.value()), std::uint32_t(layer), std::uint32_t(ordinal)};
+                }
+            };
+            auto parts = index.partition(layer, nthreads);
+            std::vector<std::thread> threads;
+            for (auto i = 1ul; i < parts.size(); i++) {
+                threads.emplace_back(replay, std::cref(parts[i]));
+            }
+            if (!parts.empty()) { replay(parts[0]); }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+        // The identity has no node; it is stored as layer -1 and kept ahead of the tree nodes of its class.
+        std::ranges::sort(entries, [](auto&& a, auto&& b) {
+            return a.canonical != b.canonical ? a.canonical < b.canonical : std::uint32_t(a.layer + 1) < std::uint32_t(b.layer + 1);
+        });
+        auto last = std::ranges::unique(entries, {}, &IndexEntry<N>::canonical);
+        entries.erase(last.begin(), last.end());
+        return SynthesisTable(tree, std::move(entries));
+    }
+    // Replays the node ending each step, so entries point at odd layers; `distance` turns them into depths.
+    [[nodiscard]] inline static SynthesisTable build(const DepthTree<N>& tree) {
+        auto all_gen = circ::CliffordGen<N>::all_generator();
+        std::vector<IndexEntry<N>> entries{{quick_reduce(BitSymplectic<N>::identity()), std::uint32_t(-1), 0}};
+        std::vector<std::byte> path;
+        for (auto depth : vw::ints(1ul, tree.depth() + 1)) {
+            auto ordinal = 0u;
+            for (auto node : circ::tree::Tree::Iter(tree.tree, 2 * depth)) {
+                path.clear();
+                for (auto g : node) {
+                    path.push_back(*g);
+                }
+                auto product = BitSymplectic<N>::identity();
+                for (auto g : DepthTree<N>::decode(path)) {
+                    product = all_gen[std::size_t(g)] * product;
+                }
+                entries.push_back({quick_reduce(product), std::uint32_t(2 * depth - 1), ordinal++});
+            }
+        }
+        std::ranges::sort(entries, [](auto&& a, auto&& b) {
+            return a.canonical != b.canonical ? a.canonical < b.canonical : std::uint32_t(a.layer + 1) < std::uint32_t(b.layer + 1);
+        });
+        auto last = std::ranges::unique(entries, {}, &IndexEntry<N>::canonical);
+        entries.erase(last.begin(), last.end());
+        return SynthesisTable(tree, std::move(entries));
+    }
+
+    [[nodiscard]] inline const std::vector<IndexEntry<N>>& index() const noexcept { return entries; }
+    [[nodiscard]] inline std::size_t size() const noexcept { return entries.size(); }
+    [[nodiscard]] inline std::size_t nlayers() const noexcept { return paths.nlayers(); }
+    [[nodiscard]] inline std::size_t layer_size(std::size_t layer) const noexcept { return paths.layer_size(layer); }
+
+    // Whether the table was built from a `DepthTree`, so that distances count parallel steps instead of generators and
+    // tree layers are half steps.
+    [[nodiscard]] inline bool depth_steps() const noexcept { return steps; }
+    // Distance of an entry in the table's metric. Code outside the table reads distances only through this.
+    [[nodiscard]] inline std::size_t distance(const IndexEntry<N>& entry) const noexcept {
+        auto nodes = std::size_t(std::uint32_t(entry.layer + 1));
+        return steps ? nodes / 2 : nodes;
+    }
+    // Largest distance the tree reaches; classes without an entry lie farther.
+    [[nodiscard]] inline std::size_t max_distance() const noexcept { return steps ? nlayers() / 2 : nlayers(); }
+
+    // Generators of node `ordinal` of `layer`, first applied first.
+    [[nodiscard]] inline std::vector<circ::CliffordGen<N>> path(std::size_t layer, std::size_t ordinal) const noexcept {
+        auto bytes = steps ? DepthTree<N>::decode(paths.path(layer, ordinal)) : paths.path(layer, ordinal);
+        return bytes | vw::transform([this](auto b) { return all_gen[std::size_t(b)]; }) | rgs::to<std::vector>();
+    }
+    [[nodiscard]] inline std::vector<circ::CliffordGen<N>> path(const IndexEntry<N>& entry) const noexcept {
+        if (entry.layer == std::uint32_t(-1)) { return {}; }
+        return path(entry.layer, entry.ordinal);
+    }
+
+    [[nodiscard]] inline const circ::tree::SuccinctIndex& tree_index() const noexcept { return paths; }
+
+    [[nodiscard]] inline const IndexEntry<N>* find(BitSymplectic<N> canonical) const noexcept {
+        auto it = std::ranges::lower_bound(entries, canonical, {}, &IndexEntry<N>::canonical);
+        return it != entries.end() && it->canonical == canonical ? &*it : nullptr;
+    }
+
+    // Empty only if the tree was truncated before reaching the target's class.
+    [[nodiscard]] inline std::optional<Synthesis<N>> synthesize(BitSymplectic<N> target) const noexcept {
+        const auto* entry = find(quick_reduce(target));
+        if (entry == nullptr) { return std::nullopt; }
+        Synthesis<N> result;
+        result.gens = path(*entry);
+        auto witness = quick_reduce_backtrack(result.product(), target);
+        result.left_perm = witness.left_perm;
+        result.left_sym = witness.left_sym;
+        result.right_perm = witness.right_perm;
+        return result;
+    }
+};
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(synthesis_table) {
+    auto tree = clfd::search::search<3>();
+    auto table = clfd::search::SynthesisTable<3>::build(tree);
+    CHECK_EQ(table.size(), 1 + 6 + 72 + 136 + 6);
+
+    auto path = "/tmp/clifford-synthesis-test-" + std::to_string(::getpid()) + ".bin";
+    circ::tree::save_mapped(tree, path);
+    auto mapped = clfd::search::SynthesisTable<3>(circ::tree::MappedTree(path), table.index());
+    ::unlink(path.c_str());
+    auto loaded = mapped;
+    auto identity = loaded.synthesize(clfd::BitSymplectic<3>::identity());
+    CHECK(identity.has_value());
+    CHECK_EQ(identity->gens.size(), 0);
+    for (auto i = 0ul; i < 1000ul; i++) {
+        auto target = clfd::BitSymplectic<3>::identity();
+        perform_random_gates(target, 20, clfd::CliffordGate<3>::all_gates(), Bv<2>(0b11));
+        auto synthesis = loaded.synthesize(target);
+        CHECK(synthesis.has_value());
+        CHECK_EQ(synthesis->matrix(), target);
+        CHECK_EQ(synthesis->gens.size(), loaded.distance(*loaded.find(clfd::quick_reduce(target))));
+        CHECK(synthesis->gens.size() <= 4);
+    }
+}
+
+// Depth tables return circuits whose generators split into `distance` layers of disjoint pairs.
+TEST_FN(synthesis_table_depth) {
+    auto tree = clfd::search::search_depth<4>(false, 2);
+    auto table = clfd::search::SynthesisTable<4>::build(tree);
+    auto all_gen = circ::CliffordGen<4>::all_generator();
+    auto pairs = 0ul;
+    for (auto i = 0ul; i < 300ul; i++) {
+        auto target = clfd::BitSymplectic<4>::identity();
+        for (auto j = 0ul; j < 2ul; j++) {
+            auto g1 = all_gen[std::experimental::randint(0ul, all_gen.size() - 1)];
+            auto g2 = all_gen[std::experimental::randint(0ul, all_gen.size() - 1)];
+            target = g1 * target;
+            if (g2.disjoint(g1)) { target = g2 * target; }
+        }
+        auto synthesis = table.synthesize(target);
+        CHECK(synthesis.has_value());
+        if (!synthesis) { continue; }
+        CHECK_EQ(synthesis->matrix(), target);
+        auto depth = table.distance(*table.find(clfd::quick_reduce(target)));
+        CHECK(depth <= 2);
+        CHECK(synthesis->gens.size() <= 2 * depth);
+        pairs += synthesis->gens.size() > depth;
+    }
+    CHECK(pairs > 0);
+    CHECK(table.depth_steps());
+    CHECK_EQ(table.max_distance(), 2);
+}
+
+// A search tree saved packed: its layers hold few children per node and pack into bitmaps and gaps, and packed layers
+// need no page alignment.
+TEST_FN(mapped_packed_search) {
+    auto tree = clfd::search::search<4>(false, {.max_layers = 4});
+    auto path = "/tmp/clifford-packed-test-" + std::to_string(::getpid()) + ".bin";
+    circ::tree::save_mapped(tree, path);
+    auto raw_size = circ::tree::MappedTree(path).file_size();
+    circ::tree::save_mapped(tree, path, circ::tree::MappedEncoding::Packed);
+    auto packed = circ::tree::MappedTree(path);
+    ::unlink(path.c_str());
+    CHECK(packed.file_size() * 3 < raw_size * 2);
+    CHECK(packed.verify());
+    for (auto i = 0ul; i < tree.nlayers(); i++) {
+        CHECK(rgs::equal(packed.layer(i).span(), tree.layers[i]));
+    }
+    auto table = clfd::search::SynthesisTable<4>::build(tree);
+    auto loaded = clfd::search::SynthesisTable<4>(std::move(packed), table.index());
+    auto all_gen = circ::CliffordGen<4>::all_generator();
+    for (auto i = 0ul; i < 200ul; i++) {
+        auto target = clfd::BitSymplectic<4>::identity();
+        for (auto j = 0ul; j < 4ul; j++) {
+            target = all_gen[std::experimental::randint(0ul, all_gen.size() - 1)] * target;
+        }
+        auto synthesis = loaded.synthesize(target);
+        CHECK(synthesis.has_value());
+        if (synthesis) { CHECK_EQ(synthesis->matrix(), target); }
+    }
+}
+// NOLINTEND
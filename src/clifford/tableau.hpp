@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <experimental/random>
+#include <numeric>
+#include <span>
+#include <variant>
+#include <vector>
+#include "../circuit/gateset/gate/gate.hpp"
+#include "../defines.hpp"
+#include "./bitsymplectic.hpp"
+#include "reduce/gates.hpp"
+
+namespace clfd {
+
+// Symplectic matrix of any width, laid out as `BitSymplectic`: rows 0..n-1 are x rows and n..2n-1 are z rows, each
+// over 2n columns. Rows are word arrays, so left operations cost O(n / 64).
+class Tableau {
+    std::size_t n;
+    std::size_t words;
+    std::vector<uint64_t> data;
+
+   public:
+    inline explicit Tableau(std::size_t n) : n(n), words((2 * n + 63) / 64), data(2 * n * words) {}
+    [[nodiscard]] inline static Tableau identity(std::size_t n) {
+        auto result = Tableau(n);
+        for (auto i = 0ul; i < 2 * n; i++) {
+            result.flip(i, i);
+        }
+        return result;
+    }
+    template <std::size_t N>
+    [[nodiscard]] inline static Tableau from(const BitSymplectic<N>& matrix) {
+        auto result = Tableau(N);
+        for (auto i = 0ul; i < 2 * N; i++) {
+            for (auto j = 0ul; j < 2 * N; j++) {
+                if (matrix.get(i, j)) { result.flip(i, j); }
+            }
+        }
+        return result;
+    }
+    // Rows `rows[i]`, `rows[i] + n` and columns `cols[j]`, `cols[j] + n` as qubits i and j of a small matrix.
+    template <std::size_t N>
+    [[nodiscard]] inline BitSymplectic<N> restrict(std::span<const std::size_t> rows, std::span<const std::size_t> cols) const noexcept {
+        assert(rows.size() == N && cols.size() == N);
+        std::array<Bv<2 * N>, 2 * N> result;
+        for (auto i = 0ul; i < 2 * N; i++) {
+            for (auto j = 0ul; j < 2 * N; j++) {
+                if (get(rows[i % N] + i / N * n, cols[j % N] + j / N * n)) { result[i] = result[i].xor_at(j, true); }
+            }
+        }
+        return BitSymplectic<N>::from_array(result);
+    }
+
+    [[nodiscard]] inline std::size_t nqubits() const noexcept { return n; }
+    // Symplectic inverse Ω Mᵀ Ω, where Ω swaps the x and z halves.
+    [[nodiscard]] inline Tableau inverse() const {
+        auto result = Tableau(n);
+        for (auto i = 0ul; i < 2 * n; i++) {
+            for (auto j = 0ul; j < 2 * n; j++) {
+                if (get((j + n) % (2 * n), (i + n) % (2 * n))) { result.flip(i, j); }
+            }
+        }
+        return result;
+    }
+    [[nodiscard]] inline bool operator==(const Tableau&) const noexcept = default;
+
+    [[nodiscard]] inline bool get(std::size_t irow, std::size_t icol) const noexcept { return (row(irow)[icol / 64] >> (icol % 64)) & 1; }
+    inline void flip(std::size_t irow, std::size_t icol) noexcept { row(irow)[icol / 64] ^= uint64_t(1) << (icol % 64); }
+    [[nodiscard]] inline std::span<uint64_t> row(std::size_t irow) noexcept { return {data.data() + irow * words, words}; }
+    [[nodiscard]] inline std::span<const uint64_t> row(std::size_t irow) const noexcept { return {data.data() + irow * words, words}; }
+
+    inline void do_hadamard_l(std::size_t irow) noexcept { std::ranges::swap_ranges(row(irow), row(irow + n)); }
+    inline void do_phase_l(std::size_t irow) noexcept { xor_row(irow + n, irow); }
+    inline void do_hphaseh_l(std::size_t irow) noexcept { xor_row(irow, irow + n); }
+    inline void do_cnot_l(std::size_t ictrl, std::size_t inot) noexcept {
+        xor_row(inot, ictrl);
+        xor_row(ictrl + n, inot + n);
+    }
+    // Qubit `q` becomes qubit `perm[q]`.
+    inline void do_permute_l(std::span<const QIdx> perm) noexcept {
+        auto old = data;
+        for (auto q = 0ul; q < n; q++) {
+            std::ranges::copy(std::span(old).subspan(q * words, words), row(perm[q]).begin());
+            std::ranges::copy(std::span(old).subspan((q + n) * words, words), row(perm[q] + n).begin());
+        }
+    }
+
+    // Applies a Clifford gate from `circ::gate`; phases are not tracked, so Paulis are the identity and S† is S.
+    inline void do_mul_l(const circ::gate::Gate& gate) noexcept {
+        using namespace circ::gate;
+        if (const auto* g1 = std::get_if<Gate1>(&gate)) {
+            auto q = g1->qubits[0];
+            if (std::holds_alternative<Gate1::H>(g1->gate)) {
+                do_hadamard_l(q);
+            } else if (std::holds_alternative<Gate1::S>(g1->gate) || std::holds_alternative<Gate1::SDG>(g1->gate)) {
+                do_phase_l(q);
+            } else if (std::holds_alternative<Gate1::SRN>(g1->gate)) {
+                do_hphaseh_l(q);
+            } else {
+                assert(std::holds_alternative<Gate1::X>(g1->gate) || std::holds_alternative<Gate1::Y>(g1->gate) ||
+                       std::holds_alternative<Gate1::Z>(g1->gate));
+            }
+        } else if (const auto* g2 = std::get_if<Gate2>(&gate)) {
+            auto [a, b] = g2->qubits;
+            if (std::holds_alternative<Gate2::CX>(g2->gate)) {
+                do_cnot_l(a, b);
+            } else if (std::holds_alternative<Gate2::CZ>(g2->gate)) {
+                do_hadamard_l(b);
+                do_cnot_l(a, b);
+                do_hadamard_l(b);
+            } else if (std::holds_alternative<Gate2::CY>(g2->gate)) {
+                do_phase_l(b);
+                do_cnot_l(a, b);
+                do_phase_l(b);
+            } else {
+                assert(std::holds_alternative<Gate2::SWAP>(g2->gate));
+                do_cnot_l(a, b);
+                do_cnot_l(b, a);
+                do_cnot_l(a, b);
+            }
+        }
+    }
+
+   private:
+    inline void xor_row(std::size_t target, std::size_t source) noexcept {
+        auto dst = row(target);
+        auto src = row(source);
+        for (auto w = 0ul; w < words; w++) {
+            dst[w] ^= src[w];
+        }
+    }
+};
+
+// Random Clifford built from `times` random H, S and CX gates.
+[[nodiscard]] inline Tableau random_tableau(std::size_t n, std::size_t times) noexcept {
+    auto result = Tableau::identity(n);
+    for (auto i = 0ul; i < times; i++) {
+        auto a = std::experimental::randint(0ul, n - 1);
+        auto b = std::experimental::randint(0ul, n - 1);
+        switch (std::experimental::randint(0, 2)) {
+            case 0: result.do_hadamard_l(a); break;
+            case 1: result.do_phase_l(a); break;
+            default:
+                if (a != b) { result.do_cnot_l(a, b); }
+        }
+    }
+    return result;
+}
+
+}  // namespace clfd
+
+// NOLINTBEGIN
+TEST_FN(tableau) {
+    using namespace circ::gate;
+    for (auto i = 0ul; i < 100ul; i++) {
+        auto small = clfd::BitSymplectic<4>::identity();
+        perform_random_gates(small, 20, clfd::CliffordGate<4>::all_gates(), Bv<2>(0b01));
+        auto large = clfd::Tableau::from(small);
+        auto q = QIdx(std::experimental::randint(0, 2));
+        large.do_mul_l(Gate2(Gate2::CX{}, q, q + 1));
+        large.do_mul_l(Gate1::H{}(q));
+        large.do_mul_l(Gate1::S{}(q + 1));
+        CHECK_EQ(large, clfd::Tableau::from(small.cnot_l(q, q + 1).hadamard_l(q).phase_l(q + 1)));
+        std::array<std::size_t, 4> all{0, 1, 2, 3};
+        CHECK_EQ(large.restrict<4>(all, all), small.cnot_l(q, q + 1).hadamard_l(q).phase_l(q + 1));
+        CHECK_EQ(large.inverse(), clfd::Tableau::from(small.cnot_l(q, q + 1).hadamard_l(q).phase_l(q + 1).inverse()));
+    }
+    auto swapped = clfd::Tableau::identity(70);
+    swapped.do_mul_l(Gate2(Gate2::SWAP{}, 3, 67));
+    std::vector<QIdx> perm(70);
+    std::iota(perm.begin(), perm.end(), QIdx(0));
+    std::swap(perm[3], perm[67]);
+    auto permuted = clfd::Tableau::identity(70);
+    permuted.do_permute_l(perm);
+    CHECK_EQ(swapped, permuted);
+}
+// NOLINTEND
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "../circuit/gateset/clifford_generator.hpp"
+#include "../circuit/tree/tree.hpp"
+#include "../utils/ranges.hpp"
+#include "./bitsymplectic.hpp"
+#include "./gate.hpp"
+#include "reduce/quick.hpp"
+#include "reduce/restricted.hpp"
+
+namespace clfd::search {
+
+// Integer cost of a generator: the CX on its (ctrl, not) pair plus the dressing op on each of the two qubits.
+template <std::size_t N>
+struct CostModel {
+    std::array<std::size_t, 3> op_cost{};
+    std::array<std::array<std::size_t, N>, N> cx_cost{};
+
+    [[nodiscard]] inline static CostModel uniform() noexcept {
+        CostModel model;
+        for (auto& row : model.cx_cost) {
+            row.fill(1);
+        }
+        return model;
+    }
+
+    [[nodiscard]] inline std::size_t cost(circ::CliffordGen<N> gen) const noexcept {
+        return cx_cost[gen.ictrl()][gen.inot()] + op_cost[std::size_t(gen.op_ctrl())] + op_cost[std::size_t(gen.op_not())];
+    }
+
+    // Relabelings that leave the CX cost table unchanged; only these may be quotiented out.
+    [[nodiscard]] inline std::vector<circ::CircPerm> automorphisms() const {
+        return qubit_perms<N>([this](auto&& perm) {
+            for (auto a = 0ul; a < N; a++) {
+                for (auto b = 0ul; b < N; b++) {
+                    if (a != b && cx_cost[perm[a]][perm[b]] != cx_cost[a][b]) { return false; }
+                }
+            }
+            return true;
+        });
+    }
+};
+
+// Tree of minimum-cost paths; `costs[l][k]` is the cost of the k-th node of layer l in iteration order.
+struct WeightedTree {
+    circ::tree::Tree tree;
+    std::vector<std::vector<std::size_t>> costs;
+};
+
+// Dijkstra over canonical classes with Dial's bucket queue (generator costs are small positive integers).
+// Classes are taken modulo the automorphisms of `cx_cost`, and modulo left local Cliffords only when all dressing ops
+// cost the same: moving an output local through a generator changes its dressing, which is free only then. Otherwise
+// nodes are matrices up to relabeling, so the cheapest circuit for a target up to output locals is the cheapest node
+// among its 6^N left local images.
+template <std::size_t N>
+WeightedTree search_weighted(const CostModel<N>& model, bool verbose = false) {  // NOLINT
+    auto all_gen = circ::CliffordGen<N>::all_generator();
+    auto gen_cost = all_gen | vw::transform([&model](auto gen) { return model.cost(gen); }) | rgs::to<std::vector>();
+    assert(rgs::all_of(gen_cost, [](auto c) { return c > 0; }));
+    auto group = model.automorphisms();
+    auto full_group = group.size() == utils::factorial(N);
+    auto free_locals = rgs::all_of(model.op_cost, [&model](auto c) { return c == model.op_cost[0]; });
+    auto reduce = [&](BitSymplectic<N> m) {
+        if (!free_locals) { return relabel_reduce(m, group); }
+        return full_group ? quick_reduce(m) : restricted_reduce(m, group);
+    };
+    auto eqcount = [&](BitSymplectic<N> m) {
+        if (!free_locals) { return relabel_reduce_eqcount(m, group); }
+        return full_group ? quick_reduce_eqcount(m) : restricted_reduce_eqcount(m, group);
+    };
+
+    struct Node {
+        BitSymplectic<N> value;
+        std::size_t parent;
+        std::size_t gen;
+        std::size_t cost;
+    };
+    struct Candidate {
+        BitSymplectic<N> value;
+        BitSymplectic<N> reduced;
+        std::size_t parent;
+        std::size_t gen;
+    };
+    auto nodes = std::vector<Node>{{BitSymplectic<N>::identity(), 0, 0, 0}};
+    auto settled = std::unordered_map<BitSymplectic<N>, std::size_t>{{reduce(BitSymplectic<N>::identity()), 0}};
+    auto buckets = std::vector<std::vector<Candidate>>(rgs::max(gen_cost) + 1);
+    auto pending = 0ul;
+    auto expand = [&](std::size_t index) {
+        for (auto g : vw::ints(0ul, all_gen.size())) {
+            auto value = all_gen[g] * nodes[index].value;
+            auto reduced = reduce(value);
+            if (settled.contains(reduced)) { continue; }
+            buckets[(nodes[index].cost + gen_cost[g]) % buckets.size()].push_back({value, reduced, index, g});
+            pending += 1;
+        }
+    };
+    auto symplectic_count = eqcount(BitSymplectic<N>::identity());
+
+    expand(0);
+    for (auto cost = 1ul; pending > 0; cost++) {
+        auto bucket = std::move(buckets[cost % buckets.size()]);
+        buckets[cost % buckets.size()].clear();
+        pending -= bucket.size();
+        for (auto& candidate : bucket) {
+            if (settled.contains(candidate.reduced)) { continue; }
+            settled.emplace(candidate.reduced, nodes.size());
+            nodes.push_back({candidate.value, candidate.parent, candidate.gen, cost});
+            symplectic_count += eqcount(candidate.reduced);
+            expand(nodes.size() - 1);
+        }
+        if (verbose && !bucket.empty()) {
+            fmt::println("Weighted search Symplectic<{}>: cost {} classes {} {}/{}", N, cost, nodes.size(), symplectic_count,
+                         symplectic_matrix_count(N));
+        }
+    }
+    assert(symplectic_count == symplectic_matrix_count(N));
+
+    auto children = std::vector<std::vector<std::size_t>>(nodes.size());
+    for (auto i : vw::ints(1ul, nodes.size())) {
+        children[nodes[i].parent].push_back(i);
+    }
+    WeightedTree result;
+    for (auto layer = std::vector<std::size_t>{0}; !layer.empty();) {
+        circ::tree::GroupedSpanBuilder builder;
+        std::vector<std::size_t> next_layer;
+        for (auto parent : layer) {
+            builder.new_span();
+            std::ranges::sort(children[parent], {}, [&nodes](auto i) { return nodes[i].gen; });
+            for (auto child : children[parent]) {
+                builder.add(circ::tree::node_byte(nodes[child].gen));
+                next_layer.push_back(child);
+            }
+        }
+        result.tree.add_layer(builder.build());
+        result.costs.push_back(next_layer | vw::transform([&nodes](auto i) { return nodes[i].cost; }) | rgs::to<std::vector>());
+        layer = std::move(next_layer);
+    }
+    return result;
+}
+
+}  // namespace clfd::search
+
+// NOLINTBEGIN
+TEST_FN(search_weighted) {
+    auto check_tree = [](const auto& model, const clfd::search::WeightedTree& weighted) {
+        auto all_gen = circ::CliffordGen<3>::all_generator();
+        auto nodes = 0ul;
+        for (auto nlayers : vw::ints(1ul, weighted.tree.nlayers() + 1)) {
+            auto index = 0ul;
+            for (auto it = circ::tree::Tree::Iter(weighted.tree, nlayers); it; ++it, ++index) {
+                auto cost = 0ul;
+                for (auto g : *it) {
+                    cost += model.cost(all_gen[std::size_t(*g)]);
+                }
+                CHECK_EQ(cost, weighted.costs[nlayers - 1][index]);
+            }
+            CHECK_EQ(index, weighted.costs[nlayers - 1].size());
+            nodes += index;
+        }
+        return nodes;
+    };
+
+    auto uniform = clfd::search::CostModel<3>::uniform();
+    auto weighted = clfd::search::search_weighted(uniform);
+    CHECK_EQ(check_tree(uniform, weighted), 220);
+    CHECK_EQ(weighted.tree.nlayers(), 5);
+
+    auto line = clfd::search::CostModel<3>{.cx_cost = {{{0, 2, 6}, {2, 0, 2}, {6, 2, 0}}}};
+    CHECK_EQ(line.automorphisms().size(), 2);
+    auto line_weighted = clfd::search::search_weighted(line);
+    check_tree(line, line_weighted);
+    CHECK_EQ(line_weighted.costs[0].front(), 2);
+}
+
+TEST_FN(search_weighted_brute) {
+    // Every node up to `max_cost` costs as much as the cheapest generator sequence to any matrix of its class, found by
+    // Dijkstra over raw matrices; with non-uniform dressing costs N = 3 already differs from cost 5 on.
+    auto check_optimal = []<std::size_t N>(const clfd::search::CostModel<N>& model, bool free_locals, std::size_t max_cost) {
+        auto all_gen = circ::CliffordGen<N>::all_generator();
+        auto group = model.automorphisms();
+        auto reduce = [&](clfd::BitSymplectic<N> m) { return free_locals ? clfd::restricted_reduce(m, group) : clfd::relabel_reduce(m, group); };
+
+        auto distance = std::unordered_map<clfd::BitSymplectic<N>, std::size_t>{{clfd::BitSymplectic<N>::identity(), 0}};
+        auto buckets = std::map<std::size_t, std::vector<clfd::BitSymplectic<N>>>{{0, {clfd::BitSymplectic<N>::identity()}}};
+        while (!buckets.empty()) {
+            auto [cost, bucket] = std::move(*buckets.begin());
+            buckets.erase(buckets.begin());
+            for (auto matrix : bucket) {
+                if (distance[matrix] != cost) { continue; }
+                for (auto gen : all_gen) {
+                    auto next = gen * matrix;
+                    if (cost + model.cost(gen) > max_cost) { continue; }
+                    auto [it, inserted] = distance.emplace(next, cost + model.cost(gen));
+                    if (!inserted && it->second <= cost + model.cost(gen)) { continue; }
+                    it->second = cost + model.cost(gen);
+                    buckets[it->second].push_back(next);
+                }
+            }
+        }
+        auto expected = std::unordered_map<clfd::BitSymplectic<N>, std::size_t>();
+        for (auto [matrix, cost] : distance) {
+            auto [it, inserted] = expected.emplace(reduce(matrix), cost);
+            it->second = std::min(it->second, cost);
+        }
+
+        auto weighted = clfd::search::search_weighted(model);
+        auto classes = std::set<clfd::BitSymplectic<N>>{reduce(clfd::BitSymplectic<N>::identity())};
+        for (auto nlayers : vw::ints(1ul, weighted.tree.nlayers() + 1)) {
+            auto index = 0ul;
+            for (auto node : circ::tree::Tree::Iter(weighted.tree, nlayers)) {
+                auto product = clfd::BitSymplectic<N>::identity();
+                for (auto g : node) {
+                    product = all_gen[std::size_t(*g)] * product;
+                }
+                auto cost = weighted.costs[nlayers - 1][index++];
+                auto it = expected.find(reduce(product));
+                if (cost > max_cost && it == expected.end()) { continue; }
+                CHECK(it != expected.end());
+                if (it != expected.end()) { CHECK_EQ(cost, it->second); }
+                classes.insert(reduce(product));
+            }
+        }
+        CHECK_EQ(classes.size(), expected.size());
+    };
+    auto all = std::numeric_limits<std::size_t>::max();
+    check_optimal(clfd::search::CostModel<2>{.op_cost = {0, 1, 3}, .cx_cost = {{{0, 1}, {2, 0}}}}, false, all);
+    check_optimal(clfd::search::CostModel<2>{.op_cost = {1, 1, 1}, .cx_cost = {{{0, 1}, {2, 0}}}}, true, all);
+    check_optimal(clfd::search::CostModel<2>{.op_cost = {2, 0, 1}, .cx_cost = {{{0, 1}, {1, 0}}}}, false, all);
+    check_optimal(clfd::search::CostModel<3>{.op_cost = {0, 1, 3}, .cx_cost = {{{0, 1, 1}, {1, 0, 1}, {1, 1, 0}}}}, false, 5);
+}
+// NOLINTEND
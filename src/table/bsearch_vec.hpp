@@ -67,6 +67,16 @@ class BSearchVec {
         return rgs::any_of(SplitIter::from(vec), [&elem](auto span) { return std::binary_search(span.begin(), span.end(), elem); });
     }
 
+    // The stored element equal to `elem`, so that fields left out of the ordering can be updated in place; valid until
+    // the next `insert`.
+    [[nodiscard]] inline T* find(const T& elem) noexcept {
+        for (auto span : SplitIter::from(vec)) {
+            auto it = std::lower_bound(span.begin(), span.end(), elem);
+            if (it != span.end() && *it == elem) { return &vec[std::size_t(&*it - vec.data())]; }
+        }
+        return nullptr;
+    }
+
     inline void insert(const T& elem) {
         vec.push_back(elem);
         auto iter = SplitIter::from(std::span(vec).subspan(0, vec.size() - 1));
@@ -120,4 +130,11 @@ TEST_FN(bsearch_vec) {
         CHECK_EQ(sorted.size(), sorted.capacity());
         CHECK(std::equal(sorted.begin(), sorted.end(), set.begin(), set.end()));
     }
+
+    table::BSearchVec<std::uint64_t> bsearch;
+    for (auto value : {5ul, 3ul, 9ul}) {
+        bsearch.insert(value);
+    }
+    CHECK(bsearch.find(4) == nullptr);
+    CHECK_EQ(*bsearch.find(9), 9);
 }
\ No newline at end of file
@@ -1,8 +1,30 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 
 #include <doctest/doctest.h>
+#include "circuit/tree/mapped.hpp"
+#include "circuit/tree/packed.hpp"
+#include "circuit/tree/prefix.hpp"
+#include "circuit/tree/succinct.hpp"
 // #include "circuit/tree/newcirc.hpp"
+#include "clifford/count.hpp"
+#include "clifford/batch.hpp"
+#include "clifford/daemon.hpp"
+#include "clifford/depth.hpp"
+#include "clifford/estimate.hpp"
+#include "clifford/greedy.hpp"
+#include "clifford/graphstate.hpp"
+#include "clifford/ida.hpp"
+#include "clifford/mitm.hpp"
+#include "clifford/peephole.hpp"
+#include "clifford/reduce/restricted.hpp"
+#include "clifford/resynth.hpp"
+#include "clifford/rules.hpp"
 #include "clifford/search.hpp"
+#include "clifford/signed.hpp"
+#include "clifford/state.hpp"
+#include "clifford/synthesis.hpp"
+#include "clifford/tableau.hpp"
+#include "clifford/weighted.hpp"
 // #include "clifford/reduce/quick.hpp"
 // #include "table/bsearch_vec.hpp"
 // #include "utils/linkedarray.hpp"
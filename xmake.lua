@@ -18,7 +18,7 @@ target("clifford")
     set_kind("binary")
     add_headerfiles("src/(**.hpp)")
     add_files("src/clifford.cpp")
-    add_packages("doctest", "fmt", "range-v3", "boost-container", "cereal")
+    add_packages("doctest", "fmt", "range-v3", "boost-container", "cereal", "nlohmann-json")
     add_defines("DOCTEST_CONFIG_DISABLE")
     set_languages("c++23")
     add_cxxflags("-Wextra")